@@ -7,8 +7,14 @@ SEXP R_git_reset(SEXP ptr, SEXP ref, SEXP typenum){
   git_checkout_options opts = GIT_CHECKOUT_OPTIONS_INIT;
   opts.checkout_strategy = GIT_CHECKOUT_SAFE;
   set_checkout_notify_cb(&opts);
+  set_checkout_sparse(&opts, repo);
   git_reset_t reset_type = Rf_asInteger(typenum);
-  bail_if(git_reset(repo, revision, reset_type, &opts), "git_reset");
+  int err = git_reset(repo, revision, reset_type, &opts);
+  /* A mixed or hard reset reads the whole tree into the index */
+  if(!err && reset_type != GIT_RESET_SOFT)
+    sparse_checkout_sync(repo, revision);
+  git_object_free(revision);
+  bail_if(err, "git_reset");
   return ptr;
 }
 
@@ -52,6 +58,7 @@ SEXP R_git_create_branch(SEXP ptr, SEXP name, SEXP ref, SEXP checkout, SEXP forc
   opts.checkout_strategy = Rf_asLogical(force) ? GIT_CHECKOUT_FORCE : GIT_CHECKOUT_SAFE;
   set_checkout_notify_cb(&opts);
   git_repository *repo = get_git_repository(ptr);
+  set_checkout_sparse(&opts, repo);
   git_object *revision = resolve_refish(ref, repo);
   bail_if(git_commit_lookup(&commit, repo, git_object_id(revision)), "git_commit_lookup");
   git_object_free(revision);
@@ -63,6 +70,7 @@ SEXP R_git_create_branch(SEXP ptr, SEXP name, SEXP ref, SEXP checkout, SEXP forc
   if(Rf_asInteger(checkout)){
     bail_if(git_object_lookup(&obj, repo, git_reference_target(branch), GIT_OBJ_ANY), "git_object_lookup");
     bail_if(git_checkout_tree(repo, obj, &opts), "git_checkout_tree");
+    sparse_checkout_sync(repo, obj);
     git_object_free(obj);
     bail_if(git_repository_set_head(repo, git_reference_name(branch)), "git_repository_set_head");
   }
@@ -101,10 +109,13 @@ SEXP R_git_checkout_branch(SEXP ptr, SEXP branch, SEXP force){
   git_checkout_options opts = GIT_CHECKOUT_OPTIONS_INIT;
   opts.checkout_strategy = Rf_asLogical(force) ? GIT_CHECKOUT_FORCE : GIT_CHECKOUT_SAFE;
   set_checkout_notify_cb(&opts);
+  set_checkout_sparse(&opts, repo);
 
   git_object *obj;
   bail_if(git_object_lookup(&obj, repo, git_reference_target(ref), GIT_OBJ_ANY), "git_object_lookup");
   bail_if(git_checkout_tree(repo, obj, &opts), "git_checkout_tree");
+  sparse_checkout_sync(repo, obj);
+  git_object_free(obj);
   bail_if(git_repository_set_head(repo, git_reference_name(ref)), "git_repository_set_head");
   git_reference_free(ref);
   return ptr;
@@ -121,10 +132,12 @@ SEXP R_git_checkout_ref(SEXP ptr, SEXP ref, SEXP force){
   git_checkout_options opts = GIT_CHECKOUT_OPTIONS_INIT;
   opts.checkout_strategy = Rf_asLogical(force) ? GIT_CHECKOUT_FORCE : GIT_CHECKOUT_SAFE;
   set_checkout_notify_cb(&opts);
+  set_checkout_sparse(&opts, repo);
 
   /* Parse the branch/tag/ref string */
   git_object *treeish = resolve_refish(ref, repo);
   bail_if(git_checkout_tree(repo, treeish, &opts), "git_checkout_tree");
+  sparse_checkout_sync(repo, treeish);
   git_object_free(treeish);
   char buf[1000];
   snprintf(buf, 999, "refs/heads/%s", CHAR(STRING_ELT(ref, 0)));
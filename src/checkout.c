@@ -0,0 +1,567 @@
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "utils.h"
+
+/* Parallel checkout: libgit2 writes the files of a checkout one by one, which dominates
+ * the wall time of a checkout with many files. Here the main thread computes which files
+ * differ between HEAD and the target tree, and a pool of threads writes the blobs
+ * to the working directory, each with its own git_repository handle. The index entries
+ * are then updated with the stat info of the new files, such that the next status does
+ * not need to hash them again. */
+
+#ifdef _WIN32
+#define lstat stat
+#define make_dir(x) mkdir(x)
+#else
+#define make_dir(x) mkdir(x, 0777)
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#if defined(__APPLE__)
+#define ST_CTIME_NSEC(st) (st).st_ctimespec.tv_nsec
+#define ST_MTIME_NSEC(st) (st).st_mtimespec.tv_nsec
+#elif defined(_WIN32)
+#define ST_CTIME_NSEC(st) 0
+#define ST_MTIME_NSEC(st) 0
+#else
+#define ST_CTIME_NSEC(st) (st).st_ctim.tv_nsec
+#define ST_MTIME_NSEC(st) (st).st_mtim.tv_nsec
+#endif
+
+typedef struct {
+  git_index_entry entry;
+  int written;
+} checkout_file;
+
+typedef struct {
+  checkout_file *files;
+  int nfiles;
+  int nchunks;
+  const char *workdir;
+  size_t *bytes;
+  int *errors;
+  char (*messages)[256];
+} checkout_pool;
+
+static void make_parent_dirs(char *path, size_t skip){
+  for(char *sep = strchr(path + skip, '/'); sep; sep = strchr(sep + 1, '/')){
+    *sep = '\0';
+    make_dir(path);
+    *sep = '/';
+  }
+}
+
+/* Writes one blob to the working directory; does not use the R API */
+static int write_file(git_repository *repo, const char *workdir, checkout_file *file, size_t *bytes){
+  char path[4096];
+  git_blob *blob = NULL;
+  git_buf buf = {0};
+  snprintf(path, sizeof(path), "%s%s", workdir, file->entry.path);
+  int err = git_blob_lookup(&blob, repo, &file->entry.id);
+  if(err)
+    return err;
+#if AT_LEAST_LIBGIT2(1, 0)
+  git_blob_filter_options opts = GIT_BLOB_FILTER_OPTIONS_INIT;
+  err = git_blob_filter(&buf, blob, file->entry.path, &opts);
+#else
+  err = git_blob_filtered_content(&buf, blob, file->entry.path, 1);
+#endif
+  git_blob_free(blob);
+  if(err)
+    return err;
+  make_parent_dirs(path, strlen(workdir));
+  unlink(path);
+#ifndef _WIN32
+  if(file->entry.mode == GIT_FILEMODE_LINK){
+    char *target = calloc(buf.size + 1, 1);
+    memcpy(target, buf.ptr, buf.size);
+    err = symlink(target, path);
+    free(target);
+  } else
+#endif
+  {
+    int mode = file->entry.mode == GIT_FILEMODE_BLOB_EXECUTABLE ? 0777 : 0666;
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, mode);
+    err = fd < 0;
+    if(!err){
+      err = write(fd, buf.ptr, buf.size) != (ssize_t) buf.size;
+      err = close(fd) || err;
+    }
+  }
+  *bytes += buf.size;
+  git_buf_free(&buf);
+  struct stat st;
+  if(err || lstat(path, &st)){
+    giterr_set_str(GITERR_OS, strerror(errno));
+    return -1;
+  }
+  file->entry.ctime.seconds = st.st_ctime;
+  file->entry.ctime.nanoseconds = ST_CTIME_NSEC(st);
+  file->entry.mtime.seconds = st.st_mtime;
+  file->entry.mtime.nanoseconds = ST_MTIME_NSEC(st);
+  file->entry.dev = st.st_dev;
+  file->entry.ino = st.st_ino;
+  file->entry.uid = st.st_uid;
+  file->entry.gid = st.st_gid;
+  file->entry.file_size = st.st_size;
+  file->written = 1;
+  return 0;
+}
+
+/* Each task writes a contiguous chunk of the files with its own repository handle */
+static void run_checkout_chunk(void *data, int i){
+  checkout_pool *pool = data;
+  git_repository *repo = NULL;
+  int start = (int) ((int64_t) pool->nfiles * i / pool->nchunks);
+  int end = (int) ((int64_t) pool->nfiles * (i + 1) / pool->nchunks);
+  int err = git_repository_open(&repo, pool->workdir);
+  for(int j = start; j < end && !err; j++){
+    if(j % 100 == 0 && gert_parallel_cancelled())
+      break;
+    err = write_file(repo, pool->workdir, &pool->files[j], &pool->bytes[i]);
+  }
+  if(err){
+    const git_error *info = giterr_last();
+    pool->errors[i] = err;
+    snprintf(pool->messages[i], 256, "%s", info ? info->message : "unknown error");
+  }
+  git_repository_free(repo);
+}
+
+static int compare_strings(const void *a, const void *b){
+  return strcmp(*(const char **) a, *(const char **) b);
+}
+
+static void collect_paths(git_diff *diff, const char **paths, size_t *n){
+  for(size_t i = 0; i < git_diff_num_deltas(diff); i++){
+    const char *path = git_diff_get_delta(diff, i)->new_file.path;
+    paths[(*n)++] = strcpy(R_alloc(strlen(path) + 1, 1), path);
+  }
+}
+
+/* Paths with local changes, sorted: staged changes (index differs from HEAD), changes in
+ * the working directory (workdir differs from index) and untracked files */
+static const char **dirty_paths(git_repository *repo, git_tree *baseline, git_index *index,
+                                git_strarray *sparse, size_t *n){
+  git_diff *staged = NULL;
+  git_diff *unstaged = NULL;
+  git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+  opts.pathspec = *sparse;
+  bail_if(git_diff_tree_to_index(&staged, repo, baseline, index, &opts), "git_diff_tree_to_index");
+  opts.flags = GIT_DIFF_INCLUDE_UNTRACKED | GIT_DIFF_RECURSE_UNTRACKED_DIRS;
+  if(git_diff_index_to_workdir(&unstaged, repo, index, &opts)){
+    git_diff_free(staged);
+    bail_if(-1, "git_diff_index_to_workdir");
+  }
+  size_t len = git_diff_num_deltas(staged) + git_diff_num_deltas(unstaged);
+  const char **paths = (const char **) R_alloc(len ? len : 1, sizeof(char *));
+  *n = 0;
+  collect_paths(staged, paths, n);
+  collect_paths(unstaged, paths, n);
+  git_diff_free(staged);
+  git_diff_free(unstaged);
+  qsort(paths, *n, sizeof(char *), compare_strings);
+  return paths;
+}
+
+static int is_dirty(const char **dirty, size_t ndirty, const char *path){
+  return bsearch(&path, dirty, ndirty, sizeof(char *), compare_strings) != NULL;
+}
+
+/* Removes a file and the directories that became empty */
+static void remove_file(const char *workdir, const char *path){
+  char buf[4096];
+  size_t len = strlen(workdir);
+  snprintf(buf, sizeof(buf), "%s%s", workdir, path);
+  if(unlink(buf) == 0){
+    char *sep;
+    while((sep = strrchr(buf, '/')) && sep > buf + len){
+      *sep = '\0';
+      if(rmdir(buf))
+        break;
+    }
+  }
+}
+
+static checkout_file *add_checkout_file(checkout_file *files, int *n, const git_diff_file *target){
+  checkout_file *file = &files[(*n)++];
+  memset(file, 0, sizeof(checkout_file));
+  file->entry.path = strcpy(R_alloc(strlen(target->path) + 1, 1), target->path);
+  file->entry.mode = target->mode;
+  git_oid_cpy(&file->entry.id, &target->id);
+  return file;
+}
+
+/* Checks out treeish into the working directory and index using nthreads threads. Unless
+ * force is set, fails without changes if this would overwrite local changes. Returns a
+ * list with statistics; the caller is responsible for updating HEAD. */
+SEXP checkout_tree_parallel(git_repository *repo, git_object *treeish, int force, int nthreads){
+  double time_start = gert_time_now();
+  const char *workdir = git_repository_workdir(repo);
+  if(workdir == NULL)
+    Rf_error("Cannot checkout files in a bare repository");
+  git_tree *tree = NULL;
+  git_index *index = NULL;
+  git_diff *diff = NULL;
+  git_strarray sparse = {0};
+  sparse_checkout_paths(repo, &sparse);
+  bail_if(git_object_peel((git_object **) &tree, treeish, GIT_OBJECT_TREE), "git_object_peel");
+  bail_if(git_repository_index(&index, repo), "git_repository_index");
+  if(git_index_has_conflicts(index)){
+    if(!force){
+      git_index_free(index);
+      git_tree_free(tree);
+      Rf_error("Cannot checkout with unresolved conflicts in the index. Use force = TRUE to discard them.");
+    }
+    git_index_conflict_cleanup(index);
+  }
+
+  /* Files that differ between HEAD and the target, like a SAFE checkout does. An unborn
+   * HEAD has no baseline tree, which diffs as empty. */
+  git_tree *baseline = NULL;
+  git_object *head = NULL;
+  if(git_revparse_single(&head, repo, "HEAD^{tree}") == 0)
+    baseline = (git_tree *) head;
+  giterr_clear();
+  git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+  opts.flags = GIT_DIFF_INCLUDE_TYPECHANGE;
+  opts.pathspec = sparse;
+  int res = git_diff_tree_to_tree(&diff, repo, baseline, tree, &opts);
+  if(res){
+    git_tree_free(baseline);
+    bail_if(res, "git_diff_tree_to_tree");
+  }
+  size_t ndirty = 0;
+  const char **dirty = dirty_paths(repo, baseline, index, &sparse, &ndirty);
+  git_tree_free(baseline);
+  size_t ndeltas = git_diff_num_deltas(diff);
+  checkout_file *files = (checkout_file *) R_alloc(ndeltas + ndirty + 1, sizeof(checkout_file));
+  const char **removals = (const char **) R_alloc(ndeltas + ndirty + 1, sizeof(char *));
+  const char **changed = (const char **) R_alloc(ndeltas + 1, sizeof(char *));
+  int nfiles = 0;
+  int nremove = 0;
+  int conflicts = 0;
+  for(size_t i = 0; i < ndeltas; i++){
+    const git_diff_delta *delta = git_diff_get_delta(diff, i);
+    changed[i] = delta->new_file.path;
+    if(!force && is_dirty(dirty, ndirty, delta->new_file.path)){
+      Rf_warningcall_immediate(R_NilValue, "Your local changes to the following file would be overwritten by checkout: %s\nUse force = TRUE to checkout anyway.", delta->new_file.path);
+      conflicts++;
+    } else if(delta->status == GIT_DELTA_DELETED){
+      removals[nremove++] = delta->old_file.path;
+    } else if(delta->new_file.mode == GIT_FILEMODE_COMMIT){
+      /* submodules are not checked out, only their commit is recorded */
+      checkout_file gitlink = {{{0}}};
+      gitlink.entry.path = delta->new_file.path;
+      gitlink.entry.mode = GIT_FILEMODE_COMMIT;
+      git_oid_cpy(&gitlink.entry.id, &delta->new_file.id);
+      git_index_add(index, &gitlink.entry);
+    } else {
+      add_checkout_file(files, &nfiles, &delta->new_file);
+    }
+  }
+
+  /* With force, local changes to files that did not change between HEAD and the target
+   * are also discarded: they are reset to the target, or removed when they are in the
+   * index but not in the target. Untracked files that are not in the target are kept. */
+  if(force){
+    qsort(changed, ndeltas, sizeof(char *), compare_strings);
+    for(size_t i = 0; i < ndirty; i++){
+      git_tree_entry *entry = NULL;
+      if(is_dirty(changed, ndeltas, dirty[i]) || (i > 0 && !strcmp(dirty[i], dirty[i-1])))
+        continue;
+      if(git_tree_entry_bypath(&entry, tree, dirty[i]) == 0){
+        if(git_tree_entry_type(entry) == GIT_OBJECT_BLOB){
+          git_diff_file target = {0};
+          target.path = dirty[i];
+          target.mode = git_tree_entry_filemode(entry);
+          git_oid_cpy(&target.id, git_tree_entry_id(entry));
+          add_checkout_file(files, &nfiles, &target);
+        }
+        git_tree_entry_free(entry);
+      } else if(git_index_get_bypath(index, dirty[i], 0)){
+        removals[nremove++] = dirty[i];
+      }
+    }
+    giterr_clear();
+  }
+  if(conflicts){
+    git_diff_free(diff);
+    git_index_free(index);
+    git_tree_free(tree);
+    giterr_set_str(GITERR_CHECKOUT, "conflicts prevent checkout");
+    bail_if(GIT_ECONFLICT, "git_checkout_tree");
+  }
+
+  /* Removals and .gitattributes go first, because filters of other files depend on them */
+  for(int i = 0; i < nremove; i++){
+    remove_file(workdir, removals[i]);
+    git_index_remove_bypath(index, removals[i]);
+  }
+  size_t attr_bytes = 0;
+  for(int i = 0; i < nfiles; i++){
+    const char *base = strrchr(files[i].entry.path, '/');
+    if(!strcmp(base ? base + 1 : files[i].entry.path, ".gitattributes"))
+      bail_if(write_file(repo, workdir, &files[i], &attr_bytes), "git_checkout_tree");
+  }
+
+  /* Write the blobs from the thread pool */
+  int nchunks = nthreads > 0 ? nthreads : 1;
+  if(nchunks > nfiles)
+    nchunks = nfiles > 0 ? nfiles : 1;
+  checkout_pool pool = {files, nfiles, nchunks, workdir};
+  pool.bytes = (size_t *) R_alloc(nchunks, sizeof(size_t));
+  pool.errors = (int *) R_alloc(nchunks, sizeof(int));
+  pool.messages = (char (*)[256]) R_alloc(nchunks, 256);
+  memset(pool.bytes, 0, nchunks * sizeof(size_t));
+  memset(pool.errors, 0, nchunks * sizeof(int));
+  double time_write = gert_time_now();
+  int interrupted = nfiles ? gert_parallel_run(nchunks, nthreads, run_checkout_chunk, &pool) : 0;
+  double time_end = gert_time_now();
+
+  /* Update the index for the files that were written, also after a failure */
+  int written = 0;
+  double bytes = attr_bytes;
+  for(int i = 0; i < nfiles; i++){
+    if(files[i].written){
+      git_index_add(index, &files[i].entry);
+      written++;
+    }
+  }
+  for(int i = 0; i < nchunks; i++)
+    bytes += pool.bytes[i];
+  int err = git_index_write(index);
+  git_diff_free(diff);
+  git_index_free(index);
+  git_tree_free(tree);
+  bail_if(err, "git_index_write");
+  for(int i = 0; i < nchunks; i++){
+    if(pool.errors[i]){
+      giterr_set_str(GITERR_CHECKOUT, pool.messages[i]);
+      bail_if(pool.errors[i], "git_checkout_tree");
+    }
+  }
+  if(interrupted)
+    Rf_error("Checkout was interrupted after writing %d of %d files", written, nfiles);
+
+  double elapsed = time_end - time_start;
+  double write_time = time_end - time_write;
+  SEXP files_out = PROTECT(Rf_ScalarInteger(written));
+  SEXP removed_out = PROTECT(Rf_ScalarInteger(nremove));
+  SEXP bytes_out = PROTECT(Rf_ScalarReal(bytes));
+  SEXP threads_out = PROTECT(Rf_ScalarInteger(nthreads));
+  SEXP elapsed_out = PROTECT(Rf_ScalarReal(elapsed));
+  SEXP files_rate = PROTECT(Rf_ScalarReal(write_time > 0 ? written / write_time : NA_REAL));
+  SEXP bytes_rate = PROTECT(Rf_ScalarReal(write_time > 0 ? bytes / write_time : NA_REAL));
+  SEXP out = build_list(7, "files", files_out, "removed", removed_out, "bytes", bytes_out,
+                        "threads", threads_out, "elapsed", elapsed_out,
+                        "files_per_sec", files_rate, "bytes_per_sec", bytes_rate);
+  UNPROTECT(7);
+  return out;
+}
+
+/* Moves HEAD like git_reset() does, after the index and working tree were updated */
+static void reset_head(git_repository *repo, git_object *target){
+  git_reference *head = NULL;
+  git_reference *out = NULL;
+  git_commit *commit = NULL;
+  bail_if(git_object_peel((git_object **) &commit, target, GIT_OBJECT_COMMIT), "git_object_peel");
+  if(git_repository_head_detached(repo) == 1){
+    bail_if(git_repository_set_head_detached(repo, git_commit_id(commit)), "git_repository_set_head_detached");
+  } else {
+    bail_if(git_repository_head(&head, repo), "git_repository_head");
+    bail_if(git_reference_set_target(&out, head, git_commit_id(commit), "reset: moving"), "git_reference_set_target");
+    git_reference_free(out);
+    git_reference_free(head);
+  }
+  git_commit_free(commit);
+  bail_if(git_repository_state_cleanup(repo), "git_repository_state_cleanup");
+}
+
+SEXP R_git_checkout_parallel(SEXP ptr, SEXP ref, SEXP force, SEXP threads, SEXP reset){
+  git_repository *repo = get_git_repository(ptr);
+  git_object *treeish = resolve_refish(ref, repo);
+  SEXP stats = PROTECT(checkout_tree_parallel(repo, treeish, Rf_asLogical(force), Rf_asInteger(threads)));
+  sparse_checkout_sync(repo, treeish);
+  if(Rf_asLogical(reset))
+    reset_head(repo, treeish);
+  git_object_free(treeish);
+  UNPROTECT(1);
+  return stats;
+}
+
+/* Writes the files of a tree into another directory, leaving the index, HEAD and the
+ * working directory of the repository untouched. */
+SEXP R_git_checkout_export(SEXP ptr, SEXP ref, SEXP dir){
+  git_repository *repo = get_git_repository(ptr);
+  git_object *treeish = resolve_refish(ref, repo);
+  git_checkout_options opts = GIT_CHECKOUT_OPTIONS_INIT;
+  opts.checkout_strategy = GIT_CHECKOUT_FORCE | GIT_CHECKOUT_RECREATE_MISSING | GIT_CHECKOUT_DONT_UPDATE_INDEX;
+  opts.target_directory = CHAR(STRING_ELT(dir, 0));
+  int err = git_checkout_tree(repo, treeish, &opts);
+  git_object_free(treeish);
+  bail_if(err, "git_checkout_tree");
+  return dir;
+}
+
+/* Dry-run planner: runs a checkout with GIT_CHECKOUT_DRY_RUN and collects the files that
+ * would be written or removed, and the local changes that conflict with it, from the
+ * notify callback. The callback runs inside libgit2, so it only collects into C memory. */
+
+typedef struct {
+  char *path;
+  const char *action;
+  git_oid oid;
+  int is_blob;
+} planned_file;
+
+typedef struct {
+  planned_file *files;
+  size_t nfiles;
+  size_t cap;
+  char **conflicts;
+  size_t nconflicts;
+  size_t conflicts_cap;
+} checkout_plan;
+
+static void *grow(void *ptr, size_t *cap, size_t n, size_t size){
+  if(n < *cap)
+    return ptr;
+  *cap = *cap ? 2 * *cap : 64;
+  return realloc(ptr, *cap * size);
+}
+
+static void add_planned_file(checkout_plan *plan, const char *path, const char *action, const git_diff_file *target){
+  plan->files = grow(plan->files, &plan->cap, plan->nfiles, sizeof(planned_file));
+  planned_file *file = &plan->files[plan->nfiles++];
+  memset(file, 0, sizeof(planned_file));
+  file->path = strdup(path);
+  file->action = action;
+  if(target){
+    file->oid = target->id;
+    file->is_blob = target->mode != GIT_FILEMODE_COMMIT;
+  }
+}
+
+static int plan_notify_cb(git_checkout_notify_t why, const char *path, const git_diff_file *baseline,
+                          const git_diff_file *target, const git_diff_file *workdir, void *payload){
+  checkout_plan *plan = payload;
+  if(why == GIT_CHECKOUT_NOTIFY_CONFLICT){
+    plan->conflicts = grow(plan->conflicts, &plan->conflicts_cap, plan->nconflicts, sizeof(char*));
+    plan->conflicts[plan->nconflicts++] = strdup(path);
+  } else if(why == GIT_CHECKOUT_NOTIFY_UPDATED){
+    if(baseline == NULL || baseline->mode == 0){
+      add_planned_file(plan, path, "create", target);
+    } else if(baseline->mode != target->mode){
+      add_planned_file(plan, path, "typechange", target);
+    } else {
+      add_planned_file(plan, path, "update", target);
+    }
+  }
+  return 0;
+}
+
+static int is_conflict(checkout_plan *plan, const char *path){
+  for(size_t i = 0; i < plan->nconflicts; i++){
+    if(!strcmp(plan->conflicts[i], path))
+      return 1;
+  }
+  return 0;
+}
+
+/* libgit2 does not notify about files that are removed, so these are found by diffing
+ * the baseline (HEAD) against the target tree, like the checkout itself does. */
+static int plan_removals(checkout_plan *plan, git_repository *repo, git_object *treeish, git_strarray *paths){
+  git_object *head = NULL;
+  git_tree *old_tree = NULL;
+  git_tree *new_tree = NULL;
+  git_diff *diff = NULL;
+  git_diff_options diffopts = GIT_DIFF_OPTIONS_INIT;
+  diffopts.pathspec = *paths;
+  if(git_revparse_single(&head, repo, "HEAD^{tree}") < 0){
+    giterr_clear();
+    return 0;
+  }
+  old_tree = (git_tree *) head;
+  int err = git_object_peel((git_object **) &new_tree, treeish, GIT_OBJECT_TREE);
+  if(err == 0)
+    err = git_diff_tree_to_tree(&diff, repo, old_tree, new_tree, &diffopts);
+  if(err == 0){
+    size_t n = git_diff_num_deltas(diff);
+    for(size_t i = 0; i < n; i++){
+      const git_diff_delta *delta = git_diff_get_delta(diff, i);
+      if(delta->status == GIT_DELTA_DELETED && !is_conflict(plan, delta->old_file.path))
+        add_planned_file(plan, delta->old_file.path, "delete", NULL);
+    }
+  }
+  git_diff_free(diff);
+  git_tree_free(new_tree);
+  git_object_free(head);
+  return err;
+}
+
+static void free_plan(checkout_plan *plan){
+  for(size_t i = 0; i < plan->nfiles; i++)
+    free(plan->files[i].path);
+  for(size_t i = 0; i < plan->nconflicts; i++)
+    free(plan->conflicts[i]);
+  free(plan->files);
+  free(plan->conflicts);
+}
+
+SEXP R_git_checkout_plan(SEXP ptr, SEXP ref, SEXP force){
+  checkout_plan plan = {0};
+  git_odb *odb = NULL;
+  git_repository *repo = get_git_repository(ptr);
+  git_object *treeish = resolve_refish(ref, repo);
+  git_checkout_options opts = GIT_CHECKOUT_OPTIONS_INIT;
+  opts.checkout_strategy = GIT_CHECKOUT_DRY_RUN | (Rf_asLogical(force) ? GIT_CHECKOUT_FORCE : GIT_CHECKOUT_SAFE);
+  opts.notify_cb = plan_notify_cb;
+  opts.notify_flags = GIT_CHECKOUT_NOTIFY_CONFLICT | GIT_CHECKOUT_NOTIFY_UPDATED;
+  opts.notify_payload = &plan;
+  set_checkout_sparse(&opts, repo);
+  int err = git_checkout_tree(repo, treeish, &opts);
+  if(err == GIT_ECONFLICT)
+    giterr_clear();
+  if(err == 0 || err == GIT_ECONFLICT)
+    err = plan_removals(&plan, repo, treeish, &opts.paths);
+  git_object_free(treeish);
+  if(err < 0){
+    free_plan(&plan);
+    bail_if(err, "git_checkout_tree");
+  }
+  if(git_repository_odb(&odb, repo) < 0){
+    free_plan(&plan);
+    bail_if(-1, "git_repository_odb");
+  }
+
+  /* Sizes are read from the object headers, without inflating the blobs */
+  SEXP paths = PROTECT(Rf_allocVector(STRSXP, plan.nfiles));
+  SEXP actions = PROTECT(Rf_allocVector(STRSXP, plan.nfiles));
+  SEXP sizes = PROTECT(Rf_allocVector(REALSXP, plan.nfiles));
+  SEXP conflicts = PROTECT(Rf_allocVector(STRSXP, plan.nconflicts));
+  for(size_t i = 0; i < plan.nfiles; i++){
+    planned_file *file = &plan.files[i];
+    size_t size = 0;
+    git_object_t type;
+    SET_STRING_ELT(paths, i, safe_char(file->path));
+    SET_STRING_ELT(actions, i, safe_char(file->action));
+    if(file->is_blob && git_odb_read_header(&size, &type, odb, &file->oid) < 0)
+      giterr_clear();
+    REAL(sizes)[i] = size;
+  }
+  for(size_t i = 0; i < plan.nconflicts; i++)
+    SET_STRING_ELT(conflicts, i, safe_char(plan.conflicts[i]));
+  git_odb_free(odb);
+  free_plan(&plan);
+  SEXP files = PROTECT(build_tibble(3, "path", paths, "action", actions, "size", sizes));
+  SEXP out = build_list(2, "files", files, "conflicts", conflicts);
+  UNPROTECT(5);
+  return out;
+}
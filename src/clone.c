@@ -30,6 +30,11 @@
 typedef struct {
   int verbose;
   int retries;
+  int cache_tried;
+  int cache_pending;
+  char cache_user[256];
+  char key_scope[100];
+  char cred_scope[100];
   SEXP getkey;
   SEXP getcred;
 } auth_callback_data_t;
@@ -140,20 +145,104 @@ git_repository *get_git_repository(SEXP ptr){
   return R_ExternalPtrAddr(ptr);
 }
 
-static int print_progress(unsigned int cur, unsigned int tot, size_t bytes, void *payload){
-  R_CheckUserInterrupt();
-  static size_t prev = 0;
-  if(prev != cur){
-    prev = cur;
+/* Handles cache the submodules that are configured in .gitmodules and the repository
+ * config, such that status and submodule lookups do not parse the config again for
+ * every submodule. Whether the cache is enabled is kept in the tag of the handle, so
+ * it can be refreshed after gert itself changed the submodule config. */
+void set_submodule_cache(SEXP ptr, int enable){
+#ifdef USE_SUBMODULE_CACHE
+  git_repository *repo = get_git_repository(ptr);
+  git_repository_submodule_cache_clear(repo);
+  if(enable && git_repository_submodule_cache_all(repo) < 0){
+    giterr_clear();
+    enable = 0;
+  }
+  R_SetExternalPtrTag(ptr, Rf_ScalarLogical(enable));
+#endif
+}
+
+void refresh_submodule_cache(SEXP ptr){
+  SEXP tag = R_ExternalPtrTag(ptr);
+  if(Rf_isLogical(tag) && Rf_asLogical(tag) == TRUE)
+    set_submodule_cache(ptr, 1);
+}
+
+SEXP R_git_submodule_cache(SEXP ptr, SEXP enable){
+  get_git_repository(ptr);
+  SEXP tag = R_ExternalPtrTag(ptr);
+  SEXP old = PROTECT(Rf_ScalarLogical(Rf_isLogical(tag) && Rf_asLogical(tag) == TRUE));
+  if(Rf_length(enable))
+    set_submodule_cache(ptr, Rf_asLogical(enable) == TRUE);
+  UNPROTECT(1);
+  return old;
+}
+
+/* Progress and statistics of a single clone, fetch or push. The auth data must be
+ * the first member because the same payload is passed to auth_callback(). */
+typedef struct {
+  auth_callback_data_t auth;
+  int verbose;
+  int background;
+  volatile int cancel;
+  double time_start;
+  double time_download;
+  double time_received;
+  double time_checkout;
+  double time_end;
+  git_transfer_progress stats;
+  unsigned int pushed_objects;
+  size_t pushed_bytes;
+  size_t checkout_files;
+  size_t nrefs;
+  size_t refs_size;
+  char **ref_names;
+  git_oid *ref_old;
+  git_oid *ref_new;
+} transfer_data;
+
+/* Background transfers can only be cancelled, they must not touch R. Transfers of
+ * a pool run are also cancelled by an interrupt of that run, but async jobs are not. */
+static int transfer_interrupt(transfer_data *data){
+  if(data->background)
+    return (data->cancel || gert_parallel_cancelled()) ? GIT_EUSER : 0;
+  if(data->verbose)
+    R_CheckUserInterrupt();
+  return 0;
+}
+
+static void print_progress(transfer_data *data, unsigned int prev, unsigned int cur, unsigned int tot){
+  if(data->verbose && !data->background && prev != cur){
     REprintf("\rTransferred %d of %d objects...", cur, tot);
     if(cur == tot)
       REprintf("done!\n");
   }
-  return 0;
 }
 
 static int fetch_progress(const git_transfer_progress *stats, void *payload){
-  return print_progress(stats->received_objects, stats->total_objects, 0, NULL);
+  transfer_data *data = payload;
+  double now = gert_time_now();
+  unsigned int prev = data->stats.received_objects;
+  if(data->time_download == 0)
+    data->time_download = now;
+  if(data->time_received == 0 && stats->received_objects == stats->total_objects)
+    data->time_received = now;
+  memcpy(&data->stats, stats, sizeof(git_transfer_progress));
+  print_progress(data, prev, stats->received_objects, stats->total_objects);
+  return transfer_interrupt(data);
+}
+
+static int push_progress(unsigned int cur, unsigned int tot, size_t bytes, void *payload){
+  transfer_data *data = payload;
+  double now = gert_time_now();
+  unsigned int prev = data->pushed_objects;
+  if(data->time_download == 0)
+    data->time_download = now;
+  if(data->time_received == 0 && cur == tot)
+    data->time_received = now;
+  data->pushed_objects = cur;
+  data->pushed_bytes = bytes;
+  print_progress(data, prev, cur, tot);
+  return transfer_interrupt(data);
 }
 
 static int remote_message(const char *refname, const char *status, void *data){
@@ -162,16 +251,178 @@ static int remote_message(const char *refname, const char *status, void *data){
 }
 
 static void checkout_progress(const char *path, size_t cur, size_t tot, void *payload){
-  R_CheckUserInterrupt();
-  static size_t prev = 0;
-  if(prev != cur){
-    prev = cur;
-    REprintf("\rChecked out %zu of %zu commits...", cur, tot);
-    if(cur == tot)
-      REprintf(" done!\n");
+  transfer_data *data = payload;
+  size_t prev = data->checkout_files;
+  if(data->time_checkout == 0)
+    data->time_checkout = gert_time_now();
+  data->checkout_files = cur;
+  if(data->verbose && !data->background){
+    R_CheckUserInterrupt();
+    if(prev != cur){
+      REprintf("\rChecked out %zu of %zu commits...", cur, tot);
+      if(cur == tot)
+        REprintf(" done!\n");
+    }
   }
 }
 
+/* From: https://github.com/libgit2/libgit2/blob/master/examples/network/fetch.c */
+static int update_cb(const char *refname, const git_oid *a, const git_oid *b, void *payload){
+  transfer_data *data = payload;
+  if(data->nrefs == data->refs_size){
+    data->refs_size = data->refs_size ? 2 * data->refs_size : 16;
+    data->ref_names = realloc(data->ref_names, data->refs_size * sizeof(char *));
+    data->ref_old = realloc(data->ref_old, data->refs_size * sizeof(git_oid));
+    data->ref_new = realloc(data->ref_new, data->refs_size * sizeof(git_oid));
+  }
+  data->ref_names[data->nrefs] = strdup(refname);
+  git_oid_cpy(&data->ref_old[data->nrefs], a);
+  git_oid_cpy(&data->ref_new[data->nrefs], b);
+  data->nrefs++;
+  if(!data->verbose || data->background)
+    return 0;
+  char a_str[GIT_OID_HEXSZ+1], b_str[GIT_OID_HEXSZ+1];
+  git_oid_fmt(b_str, b);
+  b_str[GIT_OID_HEXSZ] = '\0';
+  if (git_oid_iszero(a)) {
+    REprintf("[new]     %.20s %s\n", b_str, refname);
+  } else {
+    git_oid_fmt(a_str, a);
+    a_str[GIT_OID_HEXSZ] = '\0';
+    REprintf("[updated] %.10s..%.10s %s\n", a_str, b_str, refname);
+  }
+  return 0;
+}
+
+static void set_transfer_callbacks(git_remote_callbacks *callbacks, transfer_data *data){
+  callbacks->payload = data;
+  callbacks->update_tips = update_cb;
+  callbacks->transfer_progress = fetch_progress;
+  callbacks->push_transfer_progress = push_progress;
+}
+
+static SEXP transfer_refs(transfer_data *data){
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, data->nrefs));
+  SEXP olds = PROTECT(Rf_allocVector(STRSXP, data->nrefs));
+  SEXP news = PROTECT(Rf_allocVector(STRSXP, data->nrefs));
+  for(size_t i = 0; i < data->nrefs; i++){
+    SET_STRING_ELT(names, i, safe_char(data->ref_names[i]));
+    SET_STRING_ELT(olds, i, git_oid_iszero(&data->ref_old[i]) ? NA_STRING : safe_char(git_oid_tostr_s(&data->ref_old[i])));
+    SET_STRING_ELT(news, i, safe_char(git_oid_tostr_s(&data->ref_new[i])));
+  }
+  SEXP out = build_tibble(3, "ref", names, "old", olds, "new", news);
+  UNPROTECT(3);
+  return out;
+}
+
+/* Wall time of each phase: negotiation lasts until the first object arrives, after
+ * all objects are received they are indexed until the checkout starts (or we are done) */
+static SEXP transfer_times(transfer_data *data){
+  double end = data->time_end ? data->time_end : gert_time_now();
+  double checkout = data->time_checkout ? data->time_checkout : end;
+  double download = data->time_download ? data->time_download : checkout;
+  double received = data->time_received ? data->time_received : download;
+  SEXP out = PROTECT(Rf_allocVector(REALSXP, 4));
+  REAL(out)[0] = download - data->time_start;
+  REAL(out)[1] = received - download;
+  REAL(out)[2] = checkout > received ? checkout - received : 0;
+  REAL(out)[3] = end - checkout;
+  Rf_setAttrib(out, R_NamesSymbol, make_strvec(4, "negotiation", "download", "indexing", "checkout"));
+  UNPROTECT(1);
+  return out;
+}
+
+static SEXP transfer_stats(transfer_data *data){
+  git_transfer_progress *stats = &data->stats;
+  SEXP total = PROTECT(Rf_ScalarInteger(stats->total_objects));
+  SEXP received = PROTECT(Rf_ScalarInteger(stats->received_objects));
+  SEXP indexed = PROTECT(Rf_ScalarInteger(stats->indexed_objects));
+  SEXP local = PROTECT(Rf_ScalarInteger(stats->local_objects));
+  SEXP bytes = PROTECT(Rf_ScalarReal(stats->received_bytes));
+  SEXP total_deltas = PROTECT(Rf_ScalarInteger(stats->total_deltas));
+  SEXP indexed_deltas = PROTECT(Rf_ScalarInteger(stats->indexed_deltas));
+  SEXP pushed = PROTECT(Rf_ScalarInteger(data->pushed_objects));
+  SEXP pushed_bytes = PROTECT(Rf_ScalarReal(data->pushed_bytes));
+  SEXP time = PROTECT(transfer_times(data));
+  SEXP updated = PROTECT(transfer_refs(data));
+  SEXP out = build_list(11, "total_objects", total, "received_objects", received, "indexed_objects", indexed,
+                        "local_objects", local, "received_bytes", bytes, "total_deltas", total_deltas,
+                        "indexed_deltas", indexed_deltas, "pushed_objects", pushed, "pushed_bytes", pushed_bytes,
+                        "time", time, "updated", updated);
+  UNPROTECT(11);
+  return out;
+}
+
+static void transfer_free(transfer_data *data){
+  for(size_t i = 0; i < data->nrefs; i++)
+    free(data->ref_names[i]);
+  free(data->ref_names);
+  free(data->ref_old);
+  free(data->ref_new);
+  data->nrefs = 0;
+  data->ref_names = NULL;
+  data->ref_old = NULL;
+  data->ref_new = NULL;
+}
+
+/* When libgit2 asks for credentials again, the server rejected the credentials that
+ * were last handed out, so they must not be served from the cache anymore. */
+static const char *cache_scope(auth_callback_data_t *cb_data, gert_cred_type type){
+  const char *scope = type == GERT_CRED_SSH_KEY ? cb_data->key_scope : cb_data->cred_scope;
+  return scope[0] ? scope : NULL;
+}
+
+static void drop_rejected_credentials(auth_callback_data_t *cb_data, const char *url){
+  if(cb_data->cache_pending){
+    gert_cred_type type = cb_data->cache_pending - 1;
+    gert_cred_cache_drop(type, url, cache_scope(cb_data, type), cb_data->cache_user[0] ? cb_data->cache_user : NULL);
+    cb_data->cache_pending = 0;
+  }
+}
+
+static void remember_credentials(auth_callback_data_t *cb_data, gert_cred_type type,
+                                 const char *url, gert_cred *entry){
+  const char *scope = cache_scope(cb_data, type);
+  if(scope == NULL)
+    return;
+  gert_cred_cache_put(type, url, scope, entry);
+  cb_data->cache_pending = type + 1;
+  snprintf(cb_data->cache_user, sizeof(cb_data->cache_user), "%s", entry->username ? entry->username : "");
+}
+
+/* Cached credentials are tried once per transfer, before calling back into R. This does
+ * not use the R API, so it can run on a background thread. */
+static int cached_credentials(git_cred **cred, const char *url, const char *username,
+                              unsigned int allowed_types, auth_callback_data_t *cb_data){
+  drop_rejected_credentials(cb_data, url);
+  if(cb_data->cache_tried)
+    return GIT_PASSTHROUGH;
+  cb_data->cache_tried = 1;
+  int res = GIT_PASSTHROUGH;
+  gert_cred entry = {0};
+#if AT_LEAST_LIBGIT2(0, 20)
+  const char *key_scope = cache_scope(cb_data, GERT_CRED_SSH_KEY);
+  const char *cred_scope = cache_scope(cb_data, GERT_CRED_USERPASS);
+  if((allowed_types & GIT_CREDTYPE_SSH_KEY) && key_scope &&
+     gert_cred_cache_get(GERT_CRED_SSH_KEY, url, key_scope, username ? username : "git", &entry)){
+    if(git_cred_ssh_key_new(cred, entry.username, entry.pubkey_path, entry.key_path, entry.password) == 0)
+      res = GERT_CRED_SSH_KEY;
+  } else
+#endif
+  if((allowed_types & GIT_CREDTYPE_USERPASS_PLAINTEXT) && cred_scope &&
+     gert_cred_cache_get(GERT_CRED_USERPASS, url, cred_scope, username, &entry)){
+    if(git_cred_userpass_plaintext_new(cred, entry.username, entry.password) == 0)
+      res = GERT_CRED_USERPASS;
+  }
+  if(res != GIT_PASSTHROUGH){
+    cb_data->cache_pending = res + 1;
+    snprintf(cb_data->cache_user, sizeof(cb_data->cache_user), "%s", entry.username ? entry.username : "");
+    res = 0;
+  }
+  gert_cred_clear(&entry);
+  return res;
+}
+
 /* Examples: https://github.com/libgit2/libgit2/blob/master/tests/online/clone.c */
 static int auth_callback(git_cred **cred, const char *url, const char *username,
                                unsigned int allowed_types, void *payload){
@@ -181,6 +432,10 @@ static int auth_callback(git_cred **cred, const char *url, const char *username,
   int verbose = cb_data->verbose;
   giterr_clear();
 
+  if(cached_credentials(cred, url, username, allowed_types, cb_data) == 0){
+    print_if_verbose("Trying to authenticate using cached credentials for %s\n", url);
+    return 0;
+  }
 
 #if AT_LEAST_LIBGIT2(0, 20)
 
@@ -208,6 +463,9 @@ static int auth_callback(git_cred **cred, const char *url, const char *username,
          !git_cred_ssh_key_new(cred, ssh_user, key_data.pubkey_path,
                                key_data.key_path, key_data.pass_phrase)){
         print_if_verbose("Trying to authenticate '%s' using provided ssh-key...\n", ssh_user);
+        gert_cred entry = {(char *) ssh_user, (char *) key_data.pass_phrase,
+                           (char *) key_data.pubkey_path, (char *) key_data.key_path};
+        remember_credentials(cb_data, GERT_CRED_SSH_KEY, url, &entry);
         return 0;
       }
     }
@@ -237,7 +495,12 @@ static int auth_callback(git_cred **cred, const char *url, const char *username,
         giterr_set_str(GIT_ERROR_CALLBACK, "HTTPS Authentication failure");
         goto failure;
       } else {
-        return git_cred_userpass_plaintext_new(cred, username, pass);
+        gert_cred entry = {(char *) username, pass, NULL, NULL};
+        int res = git_cred_userpass_plaintext_new(cred, username, pass);
+        if(res == 0)
+          remember_credentials(cb_data, GERT_CRED_USERPASS, url, &entry);
+        gert_wipe_string(pass);
+        return res;
       }
     }
   }
@@ -246,35 +509,134 @@ failure:
   return GIT_EAUTH;
 }
 
+/* The R callbacks have a 'cache_scope' attribute that identifies their credentials. An
+ * empty scope means that credentials from this callback are not cached. */
+static void read_cache_scope(SEXP cb, char *buf, size_t size){
+  SEXP scope = Rf_getAttrib(cb, Rf_install("cache_scope"));
+  buf[0] = '\0';
+  if(Rf_isString(scope) && Rf_length(scope) && STRING_ELT(scope, 0) != NA_STRING)
+    snprintf(buf, size, "%s", CHAR(STRING_ELT(scope, 0)));
+}
+
 static auth_callback_data_t auth_callback_data(SEXP getkey, SEXP getcred, int verbose){
   auth_callback_data_t data_cb;
   data_cb.verbose = verbose;
   data_cb.retries = 0;
+  data_cb.cache_tried = 0;
+  data_cb.cache_pending = 0;
+  data_cb.cache_user[0] = '\0';
+  read_cache_scope(getkey, data_cb.key_scope, sizeof(data_cb.key_scope));
+  read_cache_scope(getcred, data_cb.cred_scope, sizeof(data_cb.cred_scope));
   data_cb.getcred = getcred;
   data_cb.getkey = getkey;
   return data_cb;
 }
 
-SEXP R_git_repository_init(SEXP path, SEXP is_bare){
+static transfer_data transfer_init(SEXP getkey, SEXP getcred, int verbose){
+  transfer_data data;
+  memset(&data, 0, sizeof(data));
+  data.auth = auth_callback_data(getkey, getcred, verbose);
+  data.verbose = verbose;
+  data.time_start = gert_time_now();
+  return data;
+}
+
+/* Collects the stats and frees the transfer data, then raises an error if the transfer failed */
+static SEXP transfer_finish(transfer_data *data, int err, const char *what){
+  data->time_end = gert_time_now();
+  if(err){
+    transfer_free(data);
+    bail_if(err, what);
+  }
+  SEXP out = transfer_stats(data);
+  transfer_free(data);
+  return out;
+}
+
+/* Transfers on a background thread cannot call into R. Credential lookups are deferred
+ * to the main thread, which services them while waiting for the worker or when polled. */
+typedef struct {
+  git_cred **cred;
+  const char *url;
+  const char *username;
+  unsigned int allowed_types;
+  void *payload;
+  char message[1000];
+} auth_request;
+
+static int run_auth_request(void *arg){
+  auth_request *req = arg;
+  int res = auth_callback(req->cred, req->url, req->username, req->allowed_types, req->payload);
+  const git_error *info = giterr_last();
+  if(res < 0 && info)
+    snprintf(req->message, sizeof(req->message), "%s", info->message);
+  return res;
+}
+
+static int deferred_auth_callback(git_cred **cred, const char *url, const char *username,
+                                  unsigned int allowed_types, void *payload){
+  auth_request req = {cred, url, username, allowed_types, payload, {0}};
+  transfer_data *data = payload;
+  if(cached_credentials(cred, url, username, allowed_types, &data->auth) == 0)
+    return 0;
+  int res = gert_run_on_main(run_auth_request, &req, &data->cancel);
+  if(res < 0)
+    giterr_set_str(GIT_ERROR_CALLBACK, req.message[0] ? req.message : "Authentication failure");
+  return res;
+}
+
+static void set_remote_callbacks(git_remote_callbacks *callbacks, transfer_data *data){
+  set_transfer_callbacks(callbacks, data);
+  callbacks->credentials = data->background ? deferred_auth_callback : auth_callback;
+  set_verify_handler(callbacks);
+}
+
+static void fetch_options_init(git_fetch_options *opts, transfer_data *data, int prune){
+  opts->download_tags = GIT_REMOTE_DOWNLOAD_TAGS_ALL;
+  if(prune)
+    opts->prune = GIT_FETCH_PRUNE;
+  opts->update_fetchhead = 1;
+  set_remote_callbacks(&opts->callbacks, data);
+}
+
+static void push_options_init(git_push_options *opts, transfer_data *data){
+  set_remote_callbacks(&opts->callbacks, data);
+  if(data->verbose && !data->background)
+    opts->callbacks.push_update_reference = remote_message;
+}
+
+/* Looks up a remote by name, or else treats the name as a URL */
+static int lookup_remote(git_remote **remote, git_repository *repo, const char *name){
+  if(git_remote_lookup(remote, repo, name) < 0)
+    return git_remote_create_anonymous(remote, repo, name);
+  return 0;
+}
+
+static void copy_last_error(char *buf, size_t size){
+  const git_error *info = giterr_last();
+  snprintf(buf, size, "%s", info ? info->message : "Unknown error");
+}
+
+SEXP R_git_repository_init(SEXP path, SEXP is_bare, SEXP cache){
   git_repository *repo = NULL;
   bail_if(git_repository_init(&repo, CHAR(STRING_ELT(path, 0)), Rf_asLogical(is_bare)), "git_repository_init");
-#ifdef USE_SUBMODULE_CACHE
-  git_repository_submodule_cache_all(repo);
-#endif
-  return new_git_repository(repo);
+  SEXP ptr = PROTECT(new_git_repository(repo));
+  set_submodule_cache(ptr, Rf_asLogical(cache) == TRUE);
+  UNPROTECT(1);
+  return ptr;
 }
 
-SEXP R_git_repository_open(SEXP path, SEXP search){
+SEXP R_git_repository_open(SEXP path, SEXP search, SEXP cache){
   git_repository *repo = NULL;
   if(Rf_asLogical(search)){
     bail_if(git_repository_open_ext(&repo, CHAR(STRING_ELT(path, 0)), 0, NULL), "git_repository_open_ext");
   } else {
     bail_if(git_repository_open(&repo, CHAR(STRING_ELT(path, 0))), "git_repository_open");
   }
-#ifdef USE_SUBMODULE_CACHE
-  git_repository_submodule_cache_all(repo);
-#endif
-  return new_git_repository(repo);
+  SEXP ptr = PROTECT(new_git_repository(repo));
+  set_submodule_cache(ptr, Rf_asLogical(cache) == TRUE);
+  UNPROTECT(1);
+  return ptr;
 }
 
 SEXP R_git_repository_find(SEXP path){
@@ -311,129 +673,764 @@ int create_remote_mirror(git_remote **out, git_repository *repo, const char *nam
   return error;
 }
 
+/* Borrow objects from a local reference repository, like 'git clone --reference'. The
+ * object store of the reference is added as an alternate, and its refs are copied to a
+ * temporary namespace so that the negotiation only asks the remote for missing objects. */
+#define REFERENCE_NAMESPACE "refs/gert-reference/"
+
+static int add_reference_alternate(git_repository *repo, const char *reference){
+  git_odb *odb = NULL;
+  git_repository *source = NULL;
+  git_reference_iterator *iter = NULL;
+  char *objects = NULL;
+  char *alternates = NULL;
+  int err = git_repository_open_ext(&source, reference, 0, NULL);
+  if(!err)
+    err = git_repository_odb(&odb, repo);
+  if(!err && (asprintf(&objects, "%sobjects", git_repository_path(source)) == -1 ||
+              asprintf(&alternates, "%sobjects/info/alternates", git_repository_path(repo)) == -1)){
+    giterr_set_str(GITERR_OS, "asprintf failed");
+    err = -1;
+  }
+  if(!err)
+    err = git_odb_add_disk_alternate(odb, objects);
+  if(!err){
+    FILE *fp = fopen(alternates, "w");
+    if(fp == NULL){
+      giterr_set_str(GITERR_OS, "Failed to write objects/info/alternates");
+      err = -1;
+    } else {
+      fprintf(fp, "%s\n", objects);
+      fclose(fp);
+    }
+  }
+  if(!err)
+    err = git_reference_iterator_new(&iter, source);
+  git_reference *ref = NULL;
+  for(int i = 0; !err && git_reference_next(&ref, iter) == 0; git_reference_free(ref)){
+    git_reference *resolved = NULL;
+    if(git_reference_resolve(&resolved, ref) == 0){
+      char name[100];
+      git_reference *copy = NULL;
+      snprintf(name, sizeof(name), REFERENCE_NAMESPACE "%d", i++);
+      git_reference_create(&copy, repo, name, git_reference_target(resolved), 1, NULL);
+      git_reference_free(copy);
+      git_reference_free(resolved);
+    }
+  }
+  git_reference_iterator_free(iter);
+  git_odb_free(odb);
+  git_repository_free(source);
+  free(objects);
+  free(alternates);
+  return err;
+}
+
+static void remove_reference_refs(git_repository *repo){
+  git_reference *ref = NULL;
+  git_reference_iterator *iter = NULL;
+  if(git_reference_iterator_glob_new(&iter, repo, REFERENCE_NAMESPACE "*"))
+    return;
+  while(git_reference_next(&ref, iter) == 0){
+    git_reference_delete(ref);
+    git_reference_free(ref);
+  }
+  git_reference_iterator_free(iter);
+}
+
+/* Objects that were already visited while dissociating, open addressing on the oid */
+typedef struct {
+  git_oid id;
+  int used;
+} seen_slot;
+
+typedef struct {
+  git_repository *repo;
+  git_packbuilder *pb;
+  git_odb *own;
+  seen_slot *seen;
+  size_t size;
+  size_t count;
+} dissociate_data;
+
+static size_t seen_slot_index(seen_slot *slots, size_t size, const git_oid *id){
+  size_t hash = 0;
+  memcpy(&hash, id->id, sizeof(hash));
+  size_t i = hash & (size - 1);
+  while(slots[i].used && !git_oid_equal(&slots[i].id, id))
+    i = (i + 1) & (size - 1);
+  return i;
+}
+
+/* Returns 1 if the id was not seen before, 0 if it was, or an error */
+static int mark_seen(dissociate_data *d, const git_oid *id){
+  if(2 * (d->count + 1) > d->size){
+    size_t size = d->size ? 2 * d->size : 4096;
+    seen_slot *slots = calloc(size, sizeof(seen_slot));
+    if(slots == NULL){
+      giterr_set_str(GITERR_NOMEMORY, "Failed to allocate object set");
+      return -1;
+    }
+    for(size_t i = 0; i < d->size; i++){
+      if(d->seen[i].used)
+        slots[seen_slot_index(slots, size, &d->seen[i].id)] = d->seen[i];
+    }
+    free(d->seen);
+    d->seen = slots;
+    d->size = size;
+  }
+  seen_slot *slot = &d->seen[seen_slot_index(d->seen, d->size, id)];
+  if(slot->used)
+    return 0;
+  slot->used = 1;
+  git_oid_cpy(&slot->id, id);
+  d->count++;
+  return 1;
+}
+
+/* Objects that are in our own object store are already ours, only the ones that
+ * are read from the alternate have to be copied */
+static int pack_missing(dissociate_data *d, const git_oid *id){
+  return git_odb_exists(d->own, id) ? 0 : git_packbuilder_insert(d->pb, id, NULL);
+}
+
+/* A tree that we have can still refer to subtrees or blobs that are only in the
+ * alternate, because the fetch left out everything reachable from its refs */
+static int pack_missing_tree(dissociate_data *d, const git_oid *id){
+  git_tree *tree = NULL;
+  int err = mark_seen(d, id);
+  if(err <= 0)
+    return err;
+  if(!(err = pack_missing(d, id)))
+    err = git_tree_lookup(&tree, d->repo, id);
+  for(size_t i = 0; !err && i < git_tree_entrycount(tree); i++){
+    const git_tree_entry *entry = git_tree_entry_byindex(tree, i);
+    if(git_tree_entry_type(entry) == GIT_OBJECT_TREE){
+      err = pack_missing_tree(d, git_tree_entry_id(entry));
+    } else if(git_tree_entry_type(entry) == GIT_OBJECT_BLOB && (err = mark_seen(d, git_tree_entry_id(entry))) > 0){
+      err = pack_missing(d, git_tree_entry_id(entry));
+    }
+  }
+  git_tree_free(tree);
+  return err;
+}
+
+/* Tagged commits are covered by the revwalk, but tag objects themselves and tags of
+ * trees or blobs are not */
+static int pack_tag_cb(const char *name, git_oid *oid, void *payload){
+  dissociate_data *d = payload;
+  git_object *obj = NULL;
+  int err = git_object_lookup(&obj, d->repo, oid, GIT_OBJECT_ANY);
+  while(!err && git_object_type(obj) == GIT_OBJECT_TAG){
+    git_object *target = NULL;
+    if(!(err = pack_missing(d, git_object_id(obj))))
+      err = git_tag_target(&target, (git_tag *) obj);
+    git_object_free(obj);
+    obj = target;
+  }
+  if(!err && git_object_type(obj) == GIT_OBJECT_TREE){
+    err = pack_missing_tree(d, git_object_id(obj));
+  } else if(!err && git_object_type(obj) == GIT_OBJECT_BLOB && (err = mark_seen(d, git_object_id(obj))) > 0){
+    err = pack_missing(d, git_object_id(obj));
+  }
+  git_object_free(obj);
+  return err;
+}
+
+/* Object store of the clone itself, without the alternate */
+static int own_odb(git_odb **out, const char *objects){
+  git_odb_backend *loose = NULL;
+  git_odb_backend *packed = NULL;
+  int err = git_odb_new(out);
+  if(!err && !(err = git_odb_backend_loose(&loose, objects, -1, 0, 0, 0)))
+    err = git_odb_add_backend(*out, loose, 1);
+  if(!err && !(err = git_odb_backend_pack(&packed, objects)))
+    err = git_odb_add_backend(*out, packed, 2);
+  return err;
+}
+
+/* Copies the objects reachable from our refs that are only in the reference repository
+ * into a pack of our own, like 'git clone --dissociate', after which the alternate can
+ * be dropped */
+static int dissociate_reference(git_repository *repo){
+  git_oid oid;
+  git_revwalk *walk = NULL;
+  char *objects = NULL;
+  char *pack = NULL;
+  char *alternates = NULL;
+  dissociate_data d = {repo, NULL, NULL, NULL, 0, 0};
+  int err = 0;
+  if(asprintf(&objects, "%sobjects", git_repository_path(repo)) == -1 ||
+     asprintf(&pack, "%sobjects/pack", git_repository_path(repo)) == -1 ||
+     asprintf(&alternates, "%sobjects/info/alternates", git_repository_path(repo)) == -1){
+    giterr_set_str(GITERR_OS, "asprintf failed");
+    err = -1;
+  }
+  if(!err)
+    err = own_odb(&d.own, objects);
+  if(!err)
+    err = git_packbuilder_new(&d.pb, repo);
+  if(!err)
+    err = git_revwalk_new(&walk, repo);
+  if(!err)
+    err = git_revwalk_push_glob(walk, "refs/*");
+  if(!err)
+    git_revwalk_push_head(walk);
+  while(!err && (err = git_revwalk_next(&oid, walk)) == 0){
+    git_commit *commit = NULL;
+    if(!(err = pack_missing(&d, &oid)) && !(err = git_commit_lookup(&commit, repo, &oid)))
+      err = pack_missing_tree(&d, git_commit_tree_id(commit));
+    git_commit_free(commit);
+  }
+  if(err == GIT_ITEROVER)
+    err = 0;
+  if(!err)
+    err = git_tag_foreach(repo, pack_tag_cb, &d);
+  if(!err && git_packbuilder_object_count(d.pb) > 0)
+    err = git_packbuilder_write(d.pb, pack, 0, NULL, NULL);
+  if(!err && remove(alternates)){
+    giterr_set_str(GITERR_OS, "Failed to remove objects/info/alternates");
+    err = -1;
+  }
+  git_revwalk_free(walk);
+  git_packbuilder_free(d.pb);
+  git_odb_free(d.own);
+  free(d.seen);
+  free(objects);
+  free(pack);
+  free(alternates);
+  return err;
+}
+
+/* The payload is the path of a reference repository, or NULL */
 static int repository_enable_cache(git_repository **out, const char *path, int bare, void *payload) {
   int res = git_repository_init(out, path, bare);
 #ifdef USE_SUBMODULE_CACHE
-  git_repository_submodule_cache_all(*out);
+  if(res == 0)
+    git_repository_submodule_cache_all(*out);
 #endif
+  if(res == 0 && payload)
+    res = add_reference_alternate(*out, payload);
   return res;
 }
 
-SEXP R_git_repository_clone(SEXP url, SEXP path, SEXP branch, SEXP getkey, SEXP getcred,
-                            SEXP bare, SEXP mirror, SEXP depth, SEXP verbose){
-  git_repository *repo = NULL;
-  git_clone_options clone_opts = GIT_CLONE_OPTIONS_INIT;
-  clone_opts.checkout_opts.checkout_strategy = GIT_CHECKOUT_SAFE;
-  auth_callback_data_t data_cb = auth_callback_data(getkey, getcred, Rf_asLogical(verbose));
-  clone_opts.fetch_opts.callbacks.payload = &data_cb;
-  clone_opts.fetch_opts.callbacks.credentials = auth_callback;
-  clone_opts.repository_cb = repository_enable_cache;
-
-  set_verify_handler(&clone_opts.fetch_opts.callbacks);
-
-  /* shallow clone: fetch only the last 'depth' commits (libgit2 >= 1.7) */
+/* shallow clone: fetch only the last 'depth' commits (libgit2 >= 1.7) */
+static int clone_depth(SEXP depth){
   int clone_depth = Rf_asInteger(depth);
+#if !AT_LEAST_LIBGIT2(1, 7)
   if(clone_depth > 0){
-#if AT_LEAST_LIBGIT2(1, 7)
-    clone_opts.fetch_opts.depth = clone_depth;
-#else
     Rf_warning("Shallow clone (depth) requires libgit2 >= 1.7.0. Ignoring the depth parameter.");
-#endif
+    return 0;
   }
+#endif
+  return clone_depth > 0 ? clone_depth : 0;
+}
 
-  /* Also enables download progress and user interrupt */
-  if(Rf_asLogical(verbose)){
-    clone_opts.checkout_opts.progress_cb = checkout_progress;
-    clone_opts.fetch_opts.callbacks.transfer_progress = fetch_progress;
-  }
+static void clone_options_init(git_clone_options *clone_opts, transfer_data *data, const char *branch,
+                               int bare, int mirror, int depth, const char *reference){
+  clone_opts->checkout_opts.checkout_strategy = GIT_CHECKOUT_SAFE;
+  set_remote_callbacks(&clone_opts->fetch_opts.callbacks, data);
+  clone_opts->checkout_opts.progress_cb = checkout_progress;
+  clone_opts->checkout_opts.progress_payload = data;
+  clone_opts->repository_cb = repository_enable_cache;
+  clone_opts->repository_cb_payload = (void *) reference;
+#if AT_LEAST_LIBGIT2(1, 7)
+  clone_opts->fetch_opts.depth = depth;
+#endif
 
-  if(Rf_asLogical(bare) || Rf_asLogical(mirror))
-    clone_opts.bare = TRUE;
+  if(bare || mirror)
+    clone_opts->bare = TRUE;
 
-  if(Rf_asLogical(mirror))
-    clone_opts.remote_cb = create_remote_mirror;
+  if(mirror)
+    clone_opts->remote_cb = create_remote_mirror;
 
   /* specify branch to checkout */
-  if(Rf_length(branch))
-    clone_opts.checkout_branch = CHAR(STRING_ELT(branch, 0));
+  clone_opts->checkout_branch = branch;
+}
+
+SEXP R_git_repository_clone(SEXP url, SEXP path, SEXP branch, SEXP getkey, SEXP getcred,
+                            SEXP bare, SEXP mirror, SEXP depth, SEXP reference, SEXP dissociate,
+                            SEXP sparse, SEXP threads, SEXP cache, SEXP verbose){
+  git_repository *repo = NULL;
+  git_clone_options clone_opts = GIT_CLONE_OPTIONS_INIT;
+  const char *refpath = Rf_length(reference) ? CHAR(STRING_ELT(reference, 0)) : NULL;
+  transfer_data data = transfer_init(getkey, getcred, Rf_asLogical(verbose));
+  clone_options_init(&clone_opts, &data, Rf_length(branch) ? CHAR(STRING_ELT(branch, 0)) : NULL,
+                     Rf_asLogical(bare), Rf_asLogical(mirror), clone_depth(depth), refpath);
+
+  /* sparse checkout: only check out files matching these pathspecs */
+  int nsparse = Rf_length(sparse);
+  if(nsparse){
+    clone_opts.checkout_opts.paths.count = nsparse;
+    clone_opts.checkout_opts.paths.strings = (char **) R_alloc(nsparse, sizeof(char *));
+    for(int i = 0; i < nsparse; i++)
+      clone_opts.checkout_opts.paths.strings[i] = (char *) CHAR(STRING_ELT(sparse, i));
+  }
+
+  /* files are written afterwards by the parallel checkout */
+  int parallel = Rf_asInteger(threads) > 1 && !clone_opts.bare;
+  if(parallel)
+    clone_opts.checkout_opts.checkout_strategy = GIT_CHECKOUT_NONE;
 
   /* try to clone */
-  bail_if(git_clone(&repo, CHAR(STRING_ELT(url, 0)), CHAR(STRING_ELT(path, 0)),
-                    &clone_opts), "git_clone");
+  const char *what = "git_clone";
+  int err = git_clone(&repo, CHAR(STRING_ELT(url, 0)), CHAR(STRING_ELT(path, 0)), &clone_opts);
+  if(!err && refpath){
+    remove_reference_refs(repo);
+    if(Rf_asLogical(dissociate) && (err = dissociate_reference(repo)))
+      what = "dissociate_reference";
+    if(err){
+      git_repository_free(repo);
+      repo = NULL;
+    }
+  }
+  SEXP stats = PROTECT(transfer_finish(&data, err, what));
   bail_if_null(repo, "failed to clone repo");
-  return new_git_repository(repo);
+  SEXP ptr = PROTECT(new_git_repository(repo));
+  SEXP checkout = PROTECT(R_NilValue);
+  git_object *head = NULL;
+  if(nsparse && !git_repository_is_bare(repo))
+    sparse_checkout_save(repo, sparse);
+  if((nsparse || parallel) && !git_repository_is_bare(repo) && git_revparse_single(&head, repo, "HEAD") == 0){
+    if(parallel){
+      UNPROTECT(1);
+      checkout = PROTECT(checkout_tree_parallel(repo, head, 1, Rf_asInteger(threads)));
+    }
+    if(nsparse)
+      sparse_checkout_sync(repo, head);
+    git_object_free(head);
+  }
+
+  /* the cache was filled by repository_enable_cache() for the checkout, keep or clear it
+   * like git_open() would for this handle */
+  set_submodule_cache(ptr, Rf_asLogical(cache) == TRUE);
+  SEXP out = build_list(3, "repo", ptr, "stats", stats, "checkout", checkout);
+  UNPROTECT(3);
+  return out;
 }
 
-/* From: https://github.com/libgit2/libgit2/blob/master/examples/network/fetch.c */
-static int update_cb(const char *refname, const git_oid *a, const git_oid *b, void *data){
-  char a_str[GIT_OID_HEXSZ+1], b_str[GIT_OID_HEXSZ+1];
-  git_oid_fmt(b_str, b);
-  b_str[GIT_OID_HEXSZ] = '\0';
-  if (git_oid_iszero(a)) {
-    REprintf("[new]     %.20s %s\n", b_str, refname);
-  } else {
-    git_oid_fmt(a_str, a);
-    a_str[GIT_OID_HEXSZ] = '\0';
-    REprintf("[updated] %.10s..%.10s %s\n", a_str, b_str, refname);
+/* Length of the first-parent history of a ref that is available locally */
+static int local_depth(git_repository *repo, const char *ref){
+  int depth = 0;
+  git_commit *commit = NULL;
+  git_object *head = NULL;
+  if(git_revparse_single(&head, repo, ref) || git_object_peel((git_object **) &commit, head, GIT_OBJECT_COMMIT)){
+    giterr_clear();
+    git_object_free(head);
+    return 0;
   }
-  return 0;
+  git_object_free(head);
+  while(commit){
+    git_commit *parent = NULL;
+    depth++;
+    if(git_commit_parentcount(commit) == 0 || git_commit_parent(&parent, commit, 0))
+      parent = NULL;
+    git_commit_free(commit);
+    commit = parent;
+  }
+  return depth;
+}
+
+SEXP R_git_local_depth(SEXP ptr, SEXP ref){
+  git_repository *repo = get_git_repository(ptr);
+  return Rf_ScalarInteger(local_depth(repo, CHAR(STRING_ELT(ref, 0))));
 }
 
-SEXP R_git_remote_fetch(SEXP ptr, SEXP name, SEXP refspec, SEXP getkey, SEXP getcred, SEXP prune, SEXP verbose){
+SEXP R_git_remote_fetch(SEXP ptr, SEXP name, SEXP refspec, SEXP getkey, SEXP getcred, SEXP prune,
+                        SEXP depth, SEXP deepen, SEXP verbose){
   git_remote *remote = NULL;
   git_repository *repo = get_git_repository(ptr);
-  if(git_remote_lookup(&remote, repo, CHAR(STRING_ELT(name, 0))) < 0){
-    if(git_remote_create_anonymous(&remote, repo, CHAR(STRING_ELT(name, 0))) < 0)
-      Rf_error("Remote must either be an existing remote or URL");
-  }
+  if(lookup_remote(&remote, repo, CHAR(STRING_ELT(name, 0))) < 0)
+    Rf_error("Remote must either be an existing remote or URL");
   git_strarray *rs = Rf_length(refspec) ? files_to_array(refspec) : NULL;
   git_fetch_options opts = GIT_FETCH_OPTIONS_INIT;
-  opts.download_tags = GIT_REMOTE_DOWNLOAD_TAGS_ALL;
-  if(Rf_asLogical(prune))
-    opts.prune = GIT_FETCH_PRUNE;
-  opts.update_fetchhead = 1;
-  auth_callback_data_t data_cb = auth_callback_data(getkey, getcred, Rf_asLogical(verbose));
-  opts.callbacks.payload = &data_cb;
-  opts.callbacks.credentials = auth_callback;
-  set_verify_handler(&opts.callbacks);
-
-  /* Also enables download progress and user interrupt */
-  if(Rf_asLogical(verbose)){
-    opts.callbacks.update_tips = &update_cb;
-    opts.callbacks.transfer_progress = fetch_progress;
-  }
-  bail_if(git_remote_fetch(remote, rs, &opts, NULL), "git_remote_fetch");
+  transfer_data data = transfer_init(getkey, getcred, Rf_asLogical(verbose));
+  fetch_options_init(&opts, &data, Rf_asLogical(prune));
+
+  /* shallow fetch: a depth of INT_MAX unshallows, deepen is relative to the local history */
+  int fetch_depth = Rf_length(depth) ? Rf_asInteger(depth) : 0;
+  if(Rf_length(deepen) && Rf_asInteger(deepen) > 0)
+    fetch_depth = local_depth(repo, "HEAD") + Rf_asInteger(deepen);
+#if AT_LEAST_LIBGIT2(1, 7)
+  opts.depth = fetch_depth;
+#else
+  if(fetch_depth > 0)
+    Rf_warning("Shallow fetch (depth) requires libgit2 >= 1.7.0. Ignoring the depth parameter.");
+#endif
+  int err = git_remote_fetch(remote, rs, &opts, NULL);
   git_remote_free(remote);
-  return ptr;
+  return transfer_finish(&data, err, "git_remote_fetch");
 }
 
-SEXP R_git_remote_push(SEXP ptr, SEXP name, SEXP refspec, SEXP getkey, SEXP getcred, SEXP verbose){
+/* Fetching many repositories in parallel. Each task opens its own git_repository
+ * on a worker thread, with credential lookups deferred to the main thread. */
+typedef struct {
+  transfer_data transfer;
+  const char *path;
+  const char *remote;
+  git_strarray *refspec;
+  int prune;
+  int error;
+  char message[1000];
+} fetch_task;
+
+static void run_fetch_task(void *data, int i){
+  fetch_task *task = (fetch_task *) data + i;
   git_remote *remote = NULL;
+  git_repository *repo = NULL;
+  task->transfer.time_start = gert_time_now();
+  int err = git_repository_open(&repo, task->path);
+  if(!err)
+    err = lookup_remote(&remote, repo, task->remote);
+  if(!err){
+    git_fetch_options opts = GIT_FETCH_OPTIONS_INIT;
+    fetch_options_init(&opts, &task->transfer, task->prune);
+    err = git_remote_fetch(remote, task->refspec, &opts, NULL);
+  }
+  if(err)
+    copy_last_error(task->message, sizeof(task->message));
+  task->error = err;
+  git_remote_free(remote);
+  git_repository_free(repo);
+  task->transfer.time_end = gert_time_now();
+}
+
+SEXP R_git_remote_fetch_many(SEXP paths, SEXP remotes, SEXP refspec, SEXP getkeys, SEXP getcreds,
+                             SEXP prune, SEXP threads, SEXP verbose){
+  int len = Rf_length(paths);
+  git_strarray *rs = Rf_length(refspec) ? files_to_array(refspec) : NULL;
+  fetch_task *tasks = (fetch_task *) R_alloc(len, sizeof(fetch_task));
+  memset(tasks, 0, len * sizeof(fetch_task));
+  for(int i = 0; i < len; i++){
+    tasks[i].transfer = transfer_init(VECTOR_ELT(getkeys, i), VECTOR_ELT(getcreds, i), Rf_asLogical(verbose));
+    tasks[i].transfer.background = 1;
+    tasks[i].path = CHAR(STRING_ELT(paths, i));
+    tasks[i].remote = CHAR(STRING_ELT(remotes, i));
+    tasks[i].refspec = rs;
+    tasks[i].prune = Rf_asLogical(prune);
+  }
+  int interrupted = gert_parallel_run(len, Rf_asInteger(threads), run_fetch_task, tasks);
+  if(rs){
+    git_strarray_free(rs);
+    free(rs);
+  }
+  SEXP status = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP message = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP updated = PROTECT(Rf_allocVector(VECSXP, len));
+  SEXP received = PROTECT(Rf_allocVector(INTSXP, len));
+  SEXP indexed = PROTECT(Rf_allocVector(INTSXP, len));
+  SEXP local = PROTECT(Rf_allocVector(INTSXP, len));
+  SEXP bytes = PROTECT(Rf_allocVector(REALSXP, len));
+  SEXP time = PROTECT(Rf_allocVector(REALSXP, len));
+  for(int i = 0; i < len; i++){
+    fetch_task *task = &tasks[i];
+    SET_STRING_ELT(status, i, safe_char(task->error ? "error" : "ok"));
+    SET_STRING_ELT(message, i, task->error ? safe_char(task->message) : NA_STRING);
+    SET_VECTOR_ELT(updated, i, transfer_refs(&task->transfer));
+    INTEGER(received)[i] = task->transfer.stats.received_objects;
+    INTEGER(indexed)[i] = task->transfer.stats.indexed_objects;
+    INTEGER(local)[i] = task->transfer.stats.local_objects;
+    REAL(bytes)[i] = task->transfer.stats.received_bytes;
+    REAL(time)[i] = task->transfer.time_end - task->transfer.time_start;
+    transfer_free(&task->transfer);
+  }
+  if(interrupted)
+    Rf_error("Fetch was interrupted by the user");
+  SEXP out = build_tibble(10, "path", paths, "remote", remotes, "status", status, "message", message,
+                          "updated", updated, "received_objects", received, "indexed_objects", indexed,
+                          "local_objects", local, "received_bytes", bytes, "time", time);
+  UNPROTECT(8);
+  return out;
+}
+
+/* Updating many submodules in parallel. Submodules are initialized on the main thread
+ * first, because that writes the config of the superproject. Each task then opens its
+ * own git_repository, so the clones and fetches do not share any libgit2 state. */
+typedef struct {
+  transfer_data transfer;
+  const char *path;
+  const char *name;
+  int error;
+  char head[GIT_OID_HEXSZ + 1];
+  char message[1000];
+} submodule_task;
+
+static void run_submodule_task(void *data, int i){
+  submodule_task *task = (submodule_task *) data + i;
+  git_submodule *sm = NULL;
+  git_repository *repo = NULL;
+  task->transfer.time_start = gert_time_now();
+  int err = git_repository_open(&repo, task->path);
+  if(!err)
+    err = git_submodule_lookup(&sm, repo, task->name);
+  if(!err){
+    git_submodule_update_options opts = GIT_SUBMODULE_UPDATE_OPTIONS_INIT;
+    fetch_options_init(&opts.fetch_opts, &task->transfer, 0);
+    err = git_submodule_update(sm, 0, &opts);
+  }
+  if(!err && git_submodule_index_id(sm))
+    git_oid_tostr(task->head, sizeof(task->head), git_submodule_index_id(sm));
+  if(err)
+    copy_last_error(task->message, sizeof(task->message));
+  task->error = err;
+  git_submodule_free(sm);
+  git_repository_free(repo);
+  task->transfer.time_end = gert_time_now();
+}
+
+SEXP R_git_submodule_update_many(SEXP ptr, SEXP names, SEXP init, SEXP getkeys, SEXP getcreds,
+                                 SEXP threads, SEXP verbose){
+  int len = Rf_length(names);
   git_repository *repo = get_git_repository(ptr);
-  if(git_remote_lookup(&remote, repo, CHAR(STRING_ELT(name, 0))) < 0){
-    if(git_remote_create_anonymous(&remote, repo, CHAR(STRING_ELT(name, 0))) < 0)
-      Rf_error("Remote must either be an existing remote or URL");
+  const char *path = git_repository_workdir(repo);
+  if(path == NULL)
+    Rf_error("Submodules require a repository with a working directory");
+  if(Rf_asLogical(init)){
+    for(int i = 0; i < len; i++){
+      git_submodule *sm = NULL;
+      bail_if(git_submodule_lookup(&sm, repo, CHAR(STRING_ELT(names, i))), "git_submodule_lookup");
+      int err = git_submodule_init(sm, 0);
+      git_submodule_free(sm);
+      bail_if(err, "git_submodule_init");
+    }
+  }
+  submodule_task *tasks = (submodule_task *) R_alloc(len, sizeof(submodule_task));
+  memset(tasks, 0, len * sizeof(submodule_task));
+  for(int i = 0; i < len; i++){
+    tasks[i].transfer = transfer_init(VECTOR_ELT(getkeys, i), VECTOR_ELT(getcreds, i), Rf_asLogical(verbose));
+    tasks[i].transfer.background = 1;
+    tasks[i].path = path;
+    tasks[i].name = CHAR(STRING_ELT(names, i));
+  }
+  int interrupted = gert_parallel_run(len, Rf_asInteger(threads), run_submodule_task, tasks);
+  refresh_submodule_cache(ptr);
+  SEXP status = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP message = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP head = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP received = PROTECT(Rf_allocVector(INTSXP, len));
+  SEXP bytes = PROTECT(Rf_allocVector(REALSXP, len));
+  SEXP time = PROTECT(Rf_allocVector(REALSXP, len));
+  for(int i = 0; i < len; i++){
+    submodule_task *task = &tasks[i];
+    SET_STRING_ELT(status, i, safe_char(task->error ? "error" : "ok"));
+    SET_STRING_ELT(message, i, task->error ? safe_char(task->message) : NA_STRING);
+    SET_STRING_ELT(head, i, task->head[0] ? safe_char(task->head) : NA_STRING);
+    INTEGER(received)[i] = task->transfer.stats.received_objects;
+    REAL(bytes)[i] = task->transfer.stats.received_bytes;
+    REAL(time)[i] = task->transfer.time_end - task->transfer.time_start;
+    transfer_free(&task->transfer);
   }
+  if(interrupted)
+    Rf_error("Submodule update was interrupted by the user");
+  SEXP out = build_tibble(7, "submodule", names, "status", status, "message", message, "head", head,
+                          "received_objects", received, "received_bytes", bytes, "time", time);
+  UNPROTECT(6);
+  return out;
+}
+
+SEXP R_git_remote_push(SEXP ptr, SEXP name, SEXP refspec, SEXP getkey, SEXP getcred, SEXP verbose){
+  git_remote *remote = NULL;
+  git_repository *repo = get_git_repository(ptr);
+  if(lookup_remote(&remote, repo, CHAR(STRING_ELT(name, 0))) < 0)
+    Rf_error("Remote must either be an existing remote or URL");
   git_strarray *rs = Rf_length(refspec) ? files_to_array(refspec) : NULL;
   git_push_options opts = GIT_PUSH_OPTIONS_INIT;
-  auth_callback_data_t data_cb = auth_callback_data(getkey, getcred, Rf_asLogical(verbose));
-  opts.callbacks.payload = &data_cb;
-  opts.callbacks.credentials = auth_callback;
+  transfer_data data = transfer_init(getkey, getcred, Rf_asLogical(verbose));
+  push_options_init(&opts, &data);
+  int err = git_remote_push(remote, rs, &opts);
+  git_remote_free(remote);
+  return transfer_finish(&data, err, "git_remote_push");
+}
 
-  /* Also enables download progress and user interrupt */
-  if(Rf_asLogical(verbose)){
-    opts.callbacks.update_tips = &update_cb;
-    opts.callbacks.transfer_progress = fetch_progress;
-    opts.callbacks.push_transfer_progress = print_progress;
-    opts.callbacks.push_update_reference = remote_message;
-  }
-  set_verify_handler(&opts.callbacks);
+/* Asynchronous clone, fetch and push. The transfer runs on a background thread with
+ * its own git_repository, while R polls the job for progress. Credential lookups are
+ * deferred to the main thread and serviced whenever the job is polled. */
+typedef enum {ASYNC_CLONE, ASYNC_FETCH, ASYNC_PUSH} async_op;
+
+static const char *async_what[] = {"git_clone", "git_remote_fetch", "git_remote_push"};
 
-  bail_if(git_remote_push(remote, rs, &opts), "git_remote_push");
+typedef struct {
+  transfer_data transfer;
+  gert_job *handle;
+  async_op op;
+  char *url;
+  char *path;
+  char *branch;
+  git_strarray *refspec;
+  int bare;
+  int mirror;
+  int depth;
+  int prune;
+  int error;
+  int klass;
+  char message[1000];
+} async_job;
+
+static void run_async_job(void *arg){
+  async_job *job = arg;
+  git_repository *repo = NULL;
+  git_remote *remote = NULL;
+  int err = 0;
+  if(job->op == ASYNC_CLONE){
+    git_clone_options opts = GIT_CLONE_OPTIONS_INIT;
+    clone_options_init(&opts, &job->transfer, job->branch, job->bare, job->mirror, job->depth, NULL);
+    err = git_clone(&repo, job->url, job->path, &opts);
+  } else {
+    err = git_repository_open(&repo, job->path);
+    if(!err)
+      err = lookup_remote(&remote, repo, job->url);
+    if(!err && job->op == ASYNC_FETCH){
+      git_fetch_options opts = GIT_FETCH_OPTIONS_INIT;
+      fetch_options_init(&opts, &job->transfer, job->prune);
+      err = git_remote_fetch(remote, job->refspec, &opts, NULL);
+    } else if(!err){
+      git_push_options opts = GIT_PUSH_OPTIONS_INIT;
+      push_options_init(&opts, &job->transfer);
+      err = git_remote_push(remote, job->refspec, &opts);
+    }
+  }
+  if(err){
+    const git_error *info = giterr_last();
+    job->klass = info ? info->klass : GIT_ERROR_CALLBACK;
+    copy_last_error(job->message, sizeof(job->message));
+  }
+  job->error = err;
   git_remote_free(remote);
+  git_repository_free(repo);
+  job->transfer.time_end = gert_time_now();
+}
+
+static void free_async_job(void *arg){
+  async_job *job = arg;
+  transfer_free(&job->transfer);
+  if(job->refspec){
+    git_strarray_free(job->refspec);
+    free(job->refspec);
+  }
+  free(job->url);
+  free(job->path);
+  free(job->branch);
+  free(job);
+}
+
+static void fin_async_job(SEXP ptr){
+  async_job *job = R_ExternalPtrAddr(ptr);
+  if(!job) return;
+  job->transfer.cancel = 1;
+  gert_job_release(job->handle);
+  R_ClearExternalPtr(ptr);
+}
+
+static async_job *get_async_job(SEXP ptr){
+  if(TYPEOF(ptr) != EXTPTRSXP || !Rf_inherits(ptr, "git_async_ptr"))
+    Rf_error("handle is not a git_async_ptr");
+  if(!R_ExternalPtrAddr(ptr))
+    Rf_error("pointer is dead");
+  return R_ExternalPtrAddr(ptr);
+}
+
+static async_job *async_job_new(async_op op, SEXP getkey, SEXP getcred, SEXP verbose){
+  if(!(git_libgit2_features() & GIT_FEATURE_THREADS))
+    Rf_error("Asynchronous transfers require libgit2 with thread support");
+  async_job *job = calloc(1, sizeof(async_job));
+  job->transfer = transfer_init(getkey, getcred, Rf_asLogical(verbose));
+  job->transfer.background = 1;
+  job->op = op;
+  return job;
+}
+
+/* The callbacks are kept alive by the handle, the job is cancelled when it is collected */
+static SEXP async_job_start(async_job *job, SEXP getkey, SEXP getcred){
+  job->handle = gert_job_start(run_async_job, job, free_async_job);
+  if(!job->handle){
+    free_async_job(job);
+    Rf_error("Failed to start background thread");
+  }
+  SEXP callbacks = PROTECT(Rf_allocVector(VECSXP, 2));
+  SET_VECTOR_ELT(callbacks, 0, getkey);
+  SET_VECTOR_ELT(callbacks, 1, getcred);
+  SEXP ptr = PROTECT(R_MakeExternalPtr(job, R_NilValue, callbacks));
+  R_RegisterCFinalizerEx(ptr, fin_async_job, 1);
+  Rf_setAttrib(ptr, R_ClassSymbol, Rf_mkString("git_async_ptr"));
+  UNPROTECT(2);
   return ptr;
 }
 
+SEXP R_git_async_clone(SEXP url, SEXP path, SEXP branch, SEXP getkey, SEXP getcred,
+                       SEXP bare, SEXP mirror, SEXP depth, SEXP verbose){
+  int shallow = clone_depth(depth);
+  async_job *job = async_job_new(ASYNC_CLONE, getkey, getcred, verbose);
+  job->url = strdup(CHAR(STRING_ELT(url, 0)));
+  job->path = strdup(CHAR(STRING_ELT(path, 0)));
+  job->branch = Rf_length(branch) ? strdup(CHAR(STRING_ELT(branch, 0))) : NULL;
+  job->bare = Rf_asLogical(bare);
+  job->mirror = Rf_asLogical(mirror);
+  job->depth = shallow;
+  return async_job_start(job, getkey, getcred);
+}
+
+SEXP R_git_async_fetch(SEXP ptr, SEXP name, SEXP refspec, SEXP getkey, SEXP getcred, SEXP prune, SEXP verbose){
+  git_repository *repo = get_git_repository(ptr);
+  async_job *job = async_job_new(ASYNC_FETCH, getkey, getcred, verbose);
+  job->path = strdup(git_repository_path(repo));
+  job->url = strdup(CHAR(STRING_ELT(name, 0)));
+  job->refspec = Rf_length(refspec) ? files_to_array(refspec) : NULL;
+  job->prune = Rf_asLogical(prune);
+  return async_job_start(job, getkey, getcred);
+}
+
+SEXP R_git_async_push(SEXP ptr, SEXP name, SEXP refspec, SEXP getkey, SEXP getcred, SEXP verbose){
+  git_repository *repo = get_git_repository(ptr);
+  async_job *job = async_job_new(ASYNC_PUSH, getkey, getcred, verbose);
+  job->path = strdup(git_repository_path(repo));
+  job->url = strdup(CHAR(STRING_ELT(name, 0)));
+  job->refspec = Rf_length(refspec) ? files_to_array(refspec) : NULL;
+  return async_job_start(job, getkey, getcred);
+}
+
+/* Polling also services pending credential requests of all background jobs */
+SEXP R_git_async_status(SEXP ptr){
+  async_job *job = get_async_job(ptr);
+  gert_service_main_queue();
+  int done = gert_job_done(job->handle);
+  transfer_data *data = &job->transfer;
+  double end = done ? data->time_end : gert_time_now();
+  SEXP operation = PROTECT(safe_string(async_what[job->op]));
+  SEXP isdone = PROTECT(Rf_ScalarLogical(done));
+  SEXP error = PROTECT(safe_string(done && job->error ? job->message : NULL));
+  SEXP total = PROTECT(Rf_ScalarInteger(data->stats.total_objects));
+  SEXP received = PROTECT(Rf_ScalarInteger(data->stats.received_objects));
+  SEXP indexed = PROTECT(Rf_ScalarInteger(data->stats.indexed_objects));
+  SEXP bytes = PROTECT(Rf_ScalarReal(data->stats.received_bytes));
+  SEXP pushed = PROTECT(Rf_ScalarInteger(data->pushed_objects));
+  SEXP checkout = PROTECT(Rf_ScalarReal(data->checkout_files));
+  SEXP elapsed = PROTECT(Rf_ScalarReal(end - data->time_start));
+  SEXP out = build_list(10, "operation", operation, "done", isdone, "error", error,
+                        "total_objects", total, "received_objects", received, "indexed_objects", indexed,
+                        "received_bytes", bytes, "pushed_objects", pushed, "checkout_files", checkout,
+                        "elapsed", elapsed);
+  UNPROTECT(10);
+  return out;
+}
+
+SEXP R_git_async_result(SEXP ptr){
+  async_job *job = get_async_job(ptr);
+  if(!gert_job_done(job->handle))
+    Rf_error("Background job has not finished yet");
+  if(job->error){
+    giterr_set_str(job->klass, job->message);
+    bail_if(job->error, async_what[job->op]);
+  }
+  return transfer_stats(&job->transfer);
+}
+
+SEXP R_git_async_cancel(SEXP ptr){
+  async_job *job = get_async_job(ptr);
+  job->transfer.cancel = 1;
+  gert_service_main_queue();
+  return R_NilValue;
+}
+
 SEXP R_set_session_keyphrase(SEXP key){
   if(!Rf_length(key) || !Rf_isString(key))
     Rf_error("Need to pass a string");
@@ -441,6 +1438,26 @@ SEXP R_set_session_keyphrase(SEXP key){
   return R_NilValue;
 }
 
+/* The refs advertised by a connected remote */
+static SEXP remote_heads(git_remote *remote){
+  size_t refs_len;
+  const git_remote_head **refs;
+  bail_if(git_remote_ls(&refs, &refs_len, remote), "git_remote_ls");
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, refs_len));
+  SEXP oids = PROTECT(Rf_allocVector(STRSXP, refs_len));
+  SEXP syms = PROTECT(Rf_allocVector(STRSXP, refs_len));
+  for (int i = 0; i < refs_len; i++) {
+    char oid[GIT_OID_HEXSZ + 1] = {0};
+    git_oid_fmt(oid, &refs[i]->oid);
+    SET_STRING_ELT(names, i, safe_char(refs[i]->name));
+    SET_STRING_ELT(oids, i, safe_char(oid));
+    SET_STRING_ELT(syms, i, safe_char(refs[i]->symref_target));
+  }
+  SEXP out = build_tibble(3, "ref", names, "symref", syms, "oid", oids);
+  UNPROTECT(3);
+  return out;
+}
+
 SEXP R_git_remote_ls(SEXP ptr, SEXP name, SEXP getkey, SEXP getcred, SEXP verbose){
   git_remote *remote = NULL;
   const char *remote_name = CHAR(STRING_ELT(name, 0));
@@ -451,18 +1468,10 @@ SEXP R_git_remote_ls(SEXP ptr, SEXP name, SEXP getkey, SEXP getcred, SEXP verbos
       Rf_error("Remote must either be an existing remote or URL");
   }
   git_remote_callbacks callbacks = GIT_REMOTE_CALLBACKS_INIT;
-  auth_callback_data_t data_cb = auth_callback_data(getkey, getcred, Rf_asLogical(verbose));
-  callbacks.payload = &data_cb;
+  transfer_data data = transfer_init(getkey, getcred, Rf_asLogical(verbose));
+  set_transfer_callbacks(&callbacks, &data);
   callbacks.credentials = auth_callback;
   set_verify_handler(&callbacks);
-
-  /* Also enables download progress and user interrupt */
-  if(Rf_asLogical(verbose)){
-    callbacks.update_tips = &update_cb;
-    callbacks.transfer_progress = fetch_progress;
-    callbacks.push_transfer_progress = print_progress;
-    callbacks.push_update_reference = remote_message;
-  }
   bail_if(git_remote_connect(remote, GIT_DIRECTION_FETCH, &callbacks, NULL, NULL), "git_remote_connect");
 
   /* We are connected */
@@ -493,18 +1502,152 @@ SEXP R_git_remote_ls(SEXP ptr, SEXP name, SEXP getkey, SEXP getcred, SEXP verbos
   }
 
   /* Collect references */
-  SEXP names = PROTECT(Rf_allocVector(STRSXP, refs_len));
-  SEXP oids = PROTECT(Rf_allocVector(STRSXP, refs_len));
-  SEXP syms = PROTECT(Rf_allocVector(STRSXP, refs_len));
-  for (int i = 0; i < refs_len; i++) {
-    char oid[GIT_OID_HEXSZ + 1] = {0};
-    git_oid_fmt(oid, &refs[i]->oid);
-    SET_STRING_ELT(names, i, safe_char(refs[i]->name));
-    SET_STRING_ELT(oids, i, safe_char(oid));
-    SET_STRING_ELT(syms, i, safe_char(refs[i]->symref_target));
-  }
+  SEXP out = PROTECT(remote_heads(remote));
   git_remote_free(remote);
-  SEXP out = build_tibble(3, "ref", names, "symref", syms, "oid", oids);
-  UNPROTECT(3);
+  UNPROTECT(1);
+  return out;
+}
+
+/* A remote session keeps a git_remote between operations, such that a fetch or push
+ * can reuse the connection that was opened to list the refs, instead of reconnecting
+ * and authenticating again. With the smart protocol the server ends the service after
+ * sending or receiving a pack, so the session disconnects after each fetch or push and
+ * transparently reconnects for the next operation. */
+typedef struct {
+  git_remote *remote;
+  transfer_data data;
+  git_direction direction;
+  int verbose;
+  int connects;
+  int operations;
+} remote_session;
+
+static void fin_remote_session(SEXP ptr){
+  remote_session *session = R_ExternalPtrAddr(ptr);
+  if(session == NULL)
+    return;
+  git_remote_disconnect(session->remote);
+  git_remote_free(session->remote);
+  transfer_free(&session->data);
+  free(session);
+  R_ClearExternalPtr(ptr);
+}
+
+static remote_session *get_remote_session(SEXP ptr){
+  if(TYPEOF(ptr) != EXTPTRSXP || !Rf_inherits(ptr, "git_remote_session_ptr"))
+    Rf_error("session is not a git_remote_session_ptr");
+  if(!R_ExternalPtrAddr(ptr))
+    Rf_error("session has been closed");
+  return R_ExternalPtrAddr(ptr);
+}
+
+/* The prot slot holds the repository and the credential callbacks */
+static void session_start_operation(SEXP ptr, remote_session *session){
+  SEXP prot = R_ExternalPtrProtected(ptr);
+  transfer_free(&session->data);
+  session->data = transfer_init(VECTOR_ELT(prot, 1), VECTOR_ELT(prot, 2), session->verbose);
+  session->operations++;
+}
+
+static void session_connect(remote_session *session, git_direction direction){
+  if(git_remote_connected(session->remote)){
+    if(session->direction == direction)
+      return;
+    git_remote_disconnect(session->remote);
+  }
+  git_remote_callbacks callbacks = GIT_REMOTE_CALLBACKS_INIT;
+  set_remote_callbacks(&callbacks, &session->data);
+  bail_if(git_remote_connect(session->remote, direction, &callbacks, NULL, NULL), "git_remote_connect");
+  session->direction = direction;
+  session->connects++;
+}
+
+SEXP R_git_remote_session(SEXP ptr, SEXP name, SEXP getkey, SEXP getcred, SEXP verbose){
+  git_remote *remote = NULL;
+  git_repository *repo = get_git_repository(ptr);
+  if(lookup_remote(&remote, repo, CHAR(STRING_ELT(name, 0))) < 0)
+    Rf_error("Remote must either be an existing remote or URL");
+  remote_session *session = calloc(1, sizeof(remote_session));
+  session->remote = remote;
+  session->verbose = Rf_asLogical(verbose);
+  SEXP prot = PROTECT(Rf_allocVector(VECSXP, 3));
+  SET_VECTOR_ELT(prot, 0, ptr);
+  SET_VECTOR_ELT(prot, 1, getkey);
+  SET_VECTOR_ELT(prot, 2, getcred);
+  SEXP out = PROTECT(R_MakeExternalPtr(session, R_NilValue, prot));
+  R_RegisterCFinalizerEx(out, fin_remote_session, 1);
+  Rf_setAttrib(out, R_ClassSymbol, Rf_mkString("git_remote_session_ptr"));
+  UNPROTECT(2);
+  return out;
+}
+
+SEXP R_git_remote_session_ls(SEXP ptr, SEXP push){
+  remote_session *session = get_remote_session(ptr);
+  session_start_operation(ptr, session);
+  session_connect(session, Rf_asLogical(push) ? GIT_DIRECTION_PUSH : GIT_DIRECTION_FETCH);
+  return remote_heads(session->remote);
+}
+
+SEXP R_git_remote_session_fetch(SEXP ptr, SEXP refspec, SEXP prune){
+  remote_session *session = get_remote_session(ptr);
+  session_start_operation(ptr, session);
+  session_connect(session, GIT_DIRECTION_FETCH);
+  git_strarray *rs = Rf_length(refspec) ? files_to_array(refspec) : NULL;
+  git_fetch_options opts = GIT_FETCH_OPTIONS_INIT;
+  fetch_options_init(&opts, &session->data, Rf_asLogical(prune));
+  int err = git_remote_download(session->remote, rs, &opts);
+  git_remote_disconnect(session->remote);
+  /* Same reflog message as git_remote_fetch() */
+  char reflog[1000];
+  const char *name = git_remote_name(session->remote);
+  snprintf(reflog, sizeof(reflog), "fetch %s", name ? name : git_remote_url(session->remote));
+  if(!err)
+    err = git_remote_update_tips(session->remote, &opts.callbacks, 1, opts.download_tags, reflog);
+  if(!err && Rf_asLogical(prune))
+    err = git_remote_prune(session->remote, &opts.callbacks);
+  if(rs){
+    git_strarray_free(rs);
+    free(rs);
+  }
+  return transfer_finish(&session->data, err, "git_remote_fetch");
+}
+
+SEXP R_git_remote_session_push(SEXP ptr, SEXP refspec){
+  remote_session *session = get_remote_session(ptr);
+  session_start_operation(ptr, session);
+  session_connect(session, GIT_DIRECTION_PUSH);
+  git_strarray *rs = Rf_length(refspec) ? files_to_array(refspec) : NULL;
+  git_push_options opts = GIT_PUSH_OPTIONS_INIT;
+  push_options_init(&opts, &session->data);
+  int err = git_remote_upload(session->remote, rs, &opts);
+  if(!err)
+    err = git_remote_update_tips(session->remote, &opts.callbacks, 0, 0, NULL);
+  git_remote_disconnect(session->remote);
+  if(rs){
+    git_strarray_free(rs);
+    free(rs);
+  }
+  return transfer_finish(&session->data, err, "git_remote_push");
+}
+
+SEXP R_git_remote_session_info(SEXP ptr){
+  remote_session *session = get_remote_session(ptr);
+  int connected = git_remote_connected(session->remote);
+  const char *direction = session->direction == GIT_DIRECTION_PUSH ? "push" : "fetch";
+  SEXP name = PROTECT(safe_string(git_remote_name(session->remote)));
+  SEXP url = PROTECT(safe_string(git_remote_url(session->remote)));
+  SEXP isconnected = PROTECT(Rf_ScalarLogical(connected));
+  SEXP dir = PROTECT(connected ? safe_string(direction) : Rf_ScalarString(NA_STRING));
+  SEXP connects = PROTECT(Rf_ScalarInteger(session->connects));
+  SEXP operations = PROTECT(Rf_ScalarInteger(session->operations));
+  SEXP out = build_list(6, "remote", name, "url", url, "connected", isconnected,
+                        "direction", dir, "connections", connects, "operations", operations);
+  UNPROTECT(6);
   return out;
 }
+
+SEXP R_git_remote_session_close(SEXP ptr){
+  get_remote_session(ptr);
+  fin_remote_session(ptr);
+  return R_NilValue;
+}
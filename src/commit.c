@@ -1,7 +1,7 @@
 #include <string.h>
 #include "utils.h"
 
-static SEXP make_author(const git_signature *p){
+SEXP make_author(const git_signature *p){
   char buf[2000] = "";
   if(p->name && p->email){
     snprintf(buf, 1999, "%s <%s>", p->name, p->email);
@@ -58,12 +58,59 @@ static int include_commit(git_repository *repo, git_commit *x, int64_t time_min,
   return include;
 }
 
-static int count_commit_ancestors(git_repository *repo, git_commit *x, int max, int64_t time_min, git_strarray *ps){
+/* The commits at the boundary of a shallow clone are listed in the 'shallow' file. Depending
+ * on the libgit2 version these either have a parent that cannot be looked up, or appear
+ * to have no parents at all. The oids are read into memory that is freed by R. */
+static int shallow_roots(git_repository *repo, git_oid **out){
+  if(!git_repository_is_shallow(repo))
+    return 0;
+  const char *gitdir = git_repository_path(repo);
+  size_t len = strlen(gitdir) + 10;
+  char *path = R_alloc(len, 1);
+  snprintf(path, len, "%sshallow", gitdir);
+  FILE *fp = fopen(path, "r");
+  if(fp == NULL)
+    return 0;
+  int n = 0;
+  int size = 16;
+  char line[100];
+  git_oid *roots = (git_oid *) R_alloc(size, sizeof(git_oid));
+  while(fgets(line, sizeof(line), fp)){
+    line[strcspn(line, "\r\n")] = '\0';
+    if(n == size){
+      git_oid *tmp = (git_oid *) R_alloc(2 * size, sizeof(git_oid));
+      memcpy(tmp, roots, size * sizeof(git_oid));
+      roots = tmp;
+      size *= 2;
+    }
+    if(git_oid_fromstr(&roots[n], line) == 0)
+      n++;
+  }
+  fclose(fp);
+  *out = roots;
+  return n;
+}
+
+static int is_shallow_root(git_oid *roots, int n, git_commit *commit){
+  for(int i = 0; i < n; i++){
+    if(git_oid_equal(&roots[i], git_commit_id(commit)))
+      return 1;
+  }
+  return 0;
+}
+
+static int count_commit_ancestors(git_repository *repo, git_commit *x, int max, int64_t time_min,
+                                  git_strarray *ps, int *truncated){
   git_commit *y = NULL;
   for(int i = 1; i < max; i++){
     if(!include_commit(repo, x, time_min, ps))
       i--; //do not count this commit, continue searching because history may be non linear
     int res = git_commit_parent(&y, x, 0);
+    if(res == GIT_ENOTFOUND){
+      git_oid *roots = NULL;
+      int nroots = shallow_roots(repo, &roots);
+      *truncated = is_shallow_root(roots, nroots, x);
+    }
     if(i > 1)
       git_commit_free(x);
     if(res == GIT_ENOTFOUND)
@@ -164,7 +211,7 @@ SEXP R_git_commit_create(SEXP ptr, SEXP message, SEXP author, SEXP committer,
   git_signature *commitsig = parse_signature(committer);
   bail_if(git_message_prettify(&msg, Rf_translateCharUTF8(STRING_ELT(message, 0)), 0, 0),
           "git_message_prettify");
-  const git_commit *parents[10] = {0};
+  const git_commit **parents = (const git_commit **) R_alloc(Rf_length(merge_parents) + 1, sizeof(git_commit *));
   int number_parents = create_commit_list(parents, repo, merge_parents);
 
   // Setup tree, see: https://libgit2.org/docs/examples/init/
@@ -192,7 +239,8 @@ SEXP R_git_commit_log(SEXP ptr, SEXP ref, SEXP max, SEXP after, SEXP path){
   git_strarray *psp = Rf_length(path) > 0 ? files_to_array(path) : NULL;
 
   /* Find out how many ancestors we have */
-  int len = count_commit_ancestors(repo, head, Rf_asInteger(max), min_date, psp);
+  int truncated = 0;
+  int len = count_commit_ancestors(repo, head, Rf_asInteger(max), min_date, psp, &truncated);
   SEXP ids = PROTECT(Rf_allocVector(STRSXP, len));
   SEXP msg = PROTECT(Rf_allocVector(STRSXP, len));
   SEXP author = PROTECT(Rf_allocVector(STRSXP, len));
@@ -221,6 +269,9 @@ SEXP R_git_commit_log(SEXP ptr, SEXP ref, SEXP max, SEXP after, SEXP path){
   Rf_setAttrib(times, R_ClassSymbol, make_strvec(2, "POSIXct", "POSIXt"));
   SEXP out = build_tibble(6, "commit", ids, "author", author, "time", times,
                       "files", files, "merge", merger, "message", msg);
+  /* Tells the caller that more history would be available after deepening */
+  if(truncated)
+    Rf_setAttrib(out, Rf_install("shallow"), Rf_ScalarLogical(1));
   UNPROTECT(6);
   return out;
 }
@@ -238,6 +289,13 @@ SEXP R_git_diff_list(SEXP ptr, SEXP ref){
   }
   if(diff == NULL) //e.g. shallow clone
     return R_NilValue;
+  SEXP out = diff_to_tibble(diff);
+  git_diff_free(diff);
+  return out;
+}
+
+/* One row per changed file, with the patch. The diff is not freed. */
+SEXP diff_to_tibble(git_diff *diff){
   int n = git_diff_num_deltas(diff);
   SEXP patches = PROTECT(Rf_allocVector(STRSXP, n));
   SEXP oldfiles = PROTECT(Rf_allocVector(STRSXP, n));
@@ -258,7 +316,6 @@ SEXP R_git_diff_list(SEXP ptr, SEXP ref){
       git_buf_free(&buf);
     }
   }
-  git_diff_free(diff);
   SEXP out = build_tibble(4, "status", status, "old", oldfiles, "new", newfiles, "patch", patches);
   UNPROTECT(4);
   return out;
@@ -358,8 +415,15 @@ SEXP R_git_stat_files(SEXP ptr, SEXP files, SEXP ref, SEXP max){
     INTEGER(changes)[fi] = 0L;
     SET_STRING_ELT(hashes, fi, NA_STRING);
   }
+  int truncated = 0;
+  git_oid *roots = NULL;
+  int nroots = shallow_roots(repo, &roots);
   int max_iter = Rf_length(max) ? Rf_asInteger(max) : 2147483647;
   for(int iter = 0; iter < max_iter; iter++) {
+    if(is_shallow_root(roots, nroots, commit)){
+      truncated = 1;
+      break;
+    }
     git_diff *diff = commit_to_diff(repo, commit, NULL);
     if(diff == NULL)
       Rf_error("Failed to get parent commit. Is this a shallow clone?");
@@ -389,6 +453,9 @@ SEXP R_git_stat_files(SEXP ptr, SEXP files, SEXP ref, SEXP max){
   Rf_setAttrib(modified, R_ClassSymbol, make_strvec(2, "POSIXct", "POSIXt"));
   SEXP out = build_tibble(5, "file", files, "created", created, "modified",
                           modified, "commits", changes, "head", hashes);
+  /* The caller decides whether to deepen or to give up at the shallow boundary */
+  if(truncated)
+    Rf_setAttrib(out, Rf_install("shallow"), Rf_ScalarLogical(1));
   UNPROTECT(4);
   return out;
 }
@@ -1,37 +1,234 @@
 #include <string.h>
 #include "utils.h"
 
-SEXP R_git_conflict_list(SEXP ptr){
-  int count = 0;
-  git_index *index = NULL;
-  const git_index_entry *ancestor_out = NULL;
-  const git_index_entry *our_out = NULL;
-  const git_index_entry *their_out = NULL;
+typedef struct {
+  const git_index_entry *ancestor;
+  const git_index_entry *our;
+  const git_index_entry *their;
+} conflict_entry;
+
+/* Collects the conflicts in a single pass. Each conflict has at least one entry in the
+ * index, so the number of entries bounds the number of conflicts. */
+static conflict_entry *collect_conflicts(git_index *index, int *n){
   git_index_conflict_iterator *iter = NULL;
+  conflict_entry *conflicts = (conflict_entry *) R_alloc(git_index_entrycount(index) + 1, sizeof(conflict_entry));
+  *n = 0;
+  if(!git_index_has_conflicts(index))
+    return conflicts;
+  bail_if(git_index_conflict_iterator_new(&iter, index), "git_index_conflict_iterator_new");
+  while(git_index_conflict_next(&conflicts[*n].ancestor, &conflicts[*n].our, &conflicts[*n].their, iter) == GIT_OK)
+    (*n)++;
+  git_index_conflict_iterator_free(iter);
+  return conflicts;
+}
+
+static const char *conflict_path(conflict_entry *conflict){
+  const git_index_entry *entry = conflict->our ? conflict->our : conflict->their ? conflict->their : conflict->ancestor;
+  return entry->path;
+}
+
+/* Paths with conflicts in an index, taken from whichever side of the conflict exists */
+SEXP conflict_paths(git_index *index){
+  int n = 0;
+  conflict_entry *conflicts = collect_conflicts(index, &n);
+  SEXP out = PROTECT(Rf_allocVector(STRSXP, n));
+  for(int i = 0; i < n; i++)
+    SET_STRING_ELT(out, i, safe_char(conflict_path(&conflicts[i])));
+  UNPROTECT(1);
+  return out;
+}
+
+static void set_conflict_side(const git_index_entry *entry, int i, SEXP path, SEXP oid, SEXP mode){
+  SET_STRING_ELT(path, i, safe_char(entry ? entry->path : NULL));
+  SET_STRING_ELT(oid, i, safe_char(entry ? git_oid_tostr_s(&entry->id) : NULL));
+  INTEGER(mode)[i] = entry ? (int) entry->mode : NA_INTEGER;
+}
+
+static unsigned int merge_file_style(const char *style){
+  if(!strcmp(style, "diff3"))
+    return GIT_MERGE_FILE_STYLE_DIFF3;
+  if(!strcmp(style, "zdiff3")){
+#if AT_LEAST_LIBGIT2(1, 3)
+    return GIT_MERGE_FILE_STYLE_ZDIFF3;
+#else
+    Rf_error("The zdiff3 style requires libgit2 1.3 or newer");
+#endif
+  }
+  return GIT_MERGE_FILE_STYLE_MERGE;
+}
+
+/* The ancestor, our and their side of each conflict. A side is missing (NA) for
+ * conflicts where a file was added or deleted. With content, the sides are merged with
+ * conflict markers in memory, so the result does not have to be read from disk. */
+SEXP R_git_conflict_list(SEXP ptr, SEXP content, SEXP style){
+  int n = 0;
+  git_index *index = NULL;
+  git_repository *repo = get_git_repository(ptr);
+  bail_if(git_repository_index(&index, repo), "git_repository_index");
+  conflict_entry *conflicts = collect_conflicts(index, &n);
+  SEXP ancestor = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP our = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP their = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP ancestor_oid = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP our_oid = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP their_oid = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP ancestor_mode = PROTECT(Rf_allocVector(INTSXP, n));
+  SEXP our_mode = PROTECT(Rf_allocVector(INTSXP, n));
+  SEXP their_mode = PROTECT(Rf_allocVector(INTSXP, n));
+  for(int i = 0; i < n; i++){
+    set_conflict_side(conflicts[i].ancestor, i, ancestor, ancestor_oid, ancestor_mode);
+    set_conflict_side(conflicts[i].our, i, our, our_oid, our_mode);
+    set_conflict_side(conflicts[i].their, i, their, their_oid, their_mode);
+  }
+  int with_content = Rf_asLogical(content);
+  SEXP merged = PROTECT(Rf_allocVector(STRSXP, with_content ? n : 0));
+  SEXP automergeable = PROTECT(Rf_allocVector(LGLSXP, with_content ? n : 0));
+  if(with_content){
+    git_merge_file_options opts = GIT_MERGE_FILE_OPTIONS_INIT;
+    opts.flags = merge_file_style(CHAR(STRING_ELT(style, 0)));
+    for(int i = 0; i < n; i++){
+      git_merge_file_result result = {0};
+      if(git_merge_file_from_index(&result, repo, conflicts[i].ancestor, conflicts[i].our,
+                                   conflicts[i].their, &opts) < 0){
+        /* e.g. a blob that could not be read */
+        giterr_clear();
+        SET_STRING_ELT(merged, i, NA_STRING);
+        LOGICAL(automergeable)[i] = NA_LOGICAL;
+        continue;
+      }
+      int is_text = result.ptr && memchr(result.ptr, '\0', result.len) == NULL;
+      SET_STRING_ELT(merged, i, is_text ? Rf_mkCharLenCE(result.ptr, result.len, CE_UTF8) : NA_STRING);
+      LOGICAL(automergeable)[i] = result.automergeable;
+      git_merge_file_result_free(&result);
+    }
+  }
+  git_index_free(index);
+  SEXP df = PROTECT(build_list(11, "ancestor", ancestor, "our", our, "their", their,
+                               "ancestor_oid", ancestor_oid, "our_oid", our_oid, "their_oid", their_oid,
+                               "ancestor_mode", ancestor_mode, "our_mode", our_mode, "their_mode", their_mode,
+                               "merged", merged, "automergeable", automergeable));
+  SEXP out = list_to_tibble(with_content ? df : Rf_lengthgets(df, 9));
+  UNPROTECT(12);
+  return out;
+}
+
+/* Resolves conflicts in bulk: every resolution is validated and looked up first, such
+ * that an error leaves the index untouched, and then all entries are replaced at once
+ * and the index is written a single time. A side that does not exist (e.g. ours for a
+ * file that we deleted) resolves the conflict by removing the file. */
+SEXP R_git_conflict_resolve(SEXP ptr, SEXP paths, SEXP choices, SEXP contents, SEXP checkout){
+  int n = Rf_length(paths);
+  git_index *index = NULL;
   git_repository *repo = get_git_repository(ptr);
-  bail_if(git_repository_index(&index, repo), "bail_if");
-  if(git_index_has_conflicts(index)){
-    bail_if(git_index_conflict_iterator_new(&iter, index), "git_index_conflict_iterator_new");
-    while(!git_index_conflict_next(&ancestor_out, &our_out, &their_out, iter))
-      count++;
-    git_index_conflict_iterator_free(iter);
-  }
-  SEXP ancestor = PROTECT(Rf_allocVector(STRSXP, count));
-  SEXP our = PROTECT(Rf_allocVector(STRSXP, count));
-  SEXP their = PROTECT(Rf_allocVector(STRSXP, count));
-  count = 0;
-  if(git_index_has_conflicts(index)){
-    bail_if(git_index_conflict_iterator_new(&iter, index), "git_index_conflict_iterator_new");
-    while(!git_index_conflict_next(&ancestor_out, &our_out, &their_out, iter)){
-      SET_STRING_ELT(ancestor, count, safe_char(ancestor_out->path));
-      SET_STRING_ELT(our, count, safe_char(our_out->path));
-      SET_STRING_ELT(their, count, safe_char(their_out->path));
-      count++;
-    }
-    git_index_conflict_iterator_free(iter);
+  git_index_entry *entries = (git_index_entry *) R_alloc(n + 1, sizeof(git_index_entry));
+  memset(entries, 0, (n + 1) * sizeof(git_index_entry));
+  bail_if(git_repository_index(&index, repo), "git_repository_index");
+  SEXP oids = PROTECT(Rf_allocVector(STRSXP, n));
+  for(int i = 0; i < n; i++){
+    const git_index_entry *ancestor = NULL, *ours = NULL, *theirs = NULL, *side = NULL;
+    const char *path = CHAR(STRING_ELT(paths, i));
+    const char *choice = CHAR(STRING_ELT(choices, i));
+    for(int j = 0; j < i; j++){
+      if(!strcmp(entries[j].path, path)){
+        git_index_free(index);
+        Rf_error("Path is listed more than once: %s", path);
+      }
+    }
+    if(git_index_conflict_get(&ancestor, &ours, &theirs, index, path) < 0){
+      git_index_free(index);
+      Rf_error("No conflict found for path: %s", path);
+    }
+    const git_index_entry *any = ours ? ours : theirs ? theirs : ancestor;
+    entries[i].path = path;
+    entries[i].mode = any->mode;
+    if(!strcmp(choice, "ours")){
+      side = ours;
+    } else if(!strcmp(choice, "theirs")){
+      side = theirs;
+    } else if(!strcmp(choice, "base")){
+      side = ancestor;
+    } else if(!strcmp(choice, "content")){
+      SEXP content = VECTOR_ELT(contents, i);
+      const void *buf = TYPEOF(content) == RAWSXP ? (const void *) RAW(content) : (const void *) CHAR(STRING_ELT(content, 0));
+      size_t len = TYPEOF(content) == RAWSXP ? Rf_xlength(content) : strlen(buf);
+      int res = git_blob_create_from_buffer(&entries[i].id, repo, buf, len);
+      if(res){
+        git_index_free(index);
+        bail_if(res, "git_blob_create_from_buffer");
+      }
+      entries[i].file_size = len;
+    } else if(strlen(choice) == GIT_OID_HEXSZ && git_oid_fromstr(&entries[i].id, choice) == 0){
+      size_t size = 0;
+      git_odb *odb = NULL;
+      git_object_t type = GIT_OBJECT_INVALID;
+      int res = git_repository_odb(&odb, repo);
+      if(res){
+        git_index_free(index);
+        bail_if(res, "git_repository_odb");
+      }
+      res = git_odb_read_header(&size, &type, odb, &entries[i].id);
+      git_odb_free(odb);
+      if(res || type != GIT_OBJECT_BLOB){
+        git_index_free(index);
+        giterr_clear();
+        Rf_error(res ? "Blob %s not found for path: %s" : "Object %s is not a blob, for path: %s", choice, path);
+      }
+      entries[i].file_size = size;
+    } else {
+      git_index_free(index);
+      Rf_error("Invalid resolution '%s' for path: %s", choice, path);
+    }
+    if(!strcmp(choice, "ours") || !strcmp(choice, "theirs") || !strcmp(choice, "base")){
+      if(side){
+        entries[i].id = side->id;
+        entries[i].mode = side->mode;
+        entries[i].file_size = side->file_size;
+      } else {
+        entries[i].mode = 0;
+      }
+    }
+    SET_STRING_ELT(oids, i, safe_char(entries[i].mode ? git_oid_tostr_s(&entries[i].id) : NULL));
+  }
+
+  /* Nothing can fail below, except for writing the index */
+  int res = 0;
+  const char *what = NULL;
+  for(int i = 0; i < n && !res; i++){
+    what = "git_index_conflict_remove";
+    if(!(res = git_index_conflict_remove(index, entries[i].path)) && entries[i].mode){
+      what = "git_index_add";
+      res = git_index_add(index, &entries[i]);
+    }
+  }
+  if(!res){
+    what = "git_index_write";
+    res = git_index_write(index);
+  }
+  if(res){
+    git_index_free(index);
+    bail_if(res, what);
+  }
+  if(Rf_asLogical(checkout) && !git_repository_is_bare(repo)){
+    for(int i = 0; i < n; i++){
+      if(entries[i].mode == 0){
+        char file[4000];
+        snprintf(file, sizeof(file), "%s%s", git_repository_workdir(repo), entries[i].path);
+        remove(file);
+      }
+    }
+    git_checkout_options opts = GIT_CHECKOUT_OPTIONS_INIT;
+    opts.checkout_strategy = GIT_CHECKOUT_FORCE | GIT_CHECKOUT_DISABLE_PATHSPEC_MATCH;
+    opts.paths.count = n;
+    opts.paths.strings = (char **) R_alloc(n + 1, sizeof(char *));
+    for(int i = 0; i < n; i++)
+      opts.paths.strings[i] = (char *) entries[i].path;
+    if((res = git_checkout_index(repo, index, &opts))){
+      git_index_free(index);
+      bail_if(res, "git_checkout_index");
+    }
   }
   git_index_free(index);
-  SEXP out = build_tibble(3, "ancestor", ancestor, "our", our, "their", their);
-  UNPROTECT(3);
+  SEXP out = build_tibble(3, "path", paths, "resolution", choices, "oid", oids);
+  UNPROTECT(1);
   return out;
 }
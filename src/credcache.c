@@ -0,0 +1,213 @@
+#include <pthread.h>
+#include <string.h>
+#include "utils.h"
+
+/* In-process cache of credentials that were obtained from the R callbacks, such that
+ * repeated operations against the same host do not need to call back into R. Entries
+ * are keyed by the URL prefix (scheme, host and port), username and a scope that
+ * identifies the ssh_key or password argument they came from, and expire after a TTL. Lookups are thread safe, so background transfers can authenticate without a
+ * round-trip to the main thread. Secrets are wiped from memory when an entry is
+ * dropped, for example after the server rejected it. */
+
+typedef struct cred_entry {
+  gert_cred_type type;
+  char *prefix;
+  char *scope;
+  gert_cred cred;
+  double expires;
+  struct cred_entry *next;
+} cred_entry;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static cred_entry *cache = NULL;
+static double cache_ttl = 900;
+
+void gert_wipe_string(char *str){
+  if(str == NULL)
+    return;
+  volatile char *p = str;
+  while(*p)
+    *p++ = '\0';
+  free(str);
+}
+
+static char *copy_string(const char *str){
+  return str ? strdup(str) : NULL;
+}
+
+void gert_cred_clear(gert_cred *cred){
+  gert_wipe_string(cred->username);
+  gert_wipe_string(cred->password);
+  gert_wipe_string(cred->pubkey_path);
+  gert_wipe_string(cred->key_path);
+  memset(cred, 0, sizeof(gert_cred));
+}
+
+static void free_entry(cred_entry *entry){
+  gert_cred_clear(&entry->cred);
+  free(entry->prefix);
+  free(entry->scope);
+  free(entry);
+}
+
+/* E.g. https://user@github.com:443/r-lib/gert becomes https://github.com:443/ and
+ * git@github.com:r-lib/gert becomes github.com: */
+static void url_prefix(const char *url, char *buf, size_t size){
+  const char *scheme = strstr(url, "://");
+  const char *host = scheme ? scheme + 3 : url;
+  const char *end = host + strcspn(host, scheme ? "/" : ":/");
+  const char *at = memchr(host, '@', end - host);
+  if(at)
+    host = at + 1;
+  size_t len = scheme ? scheme + 3 - url : 0;
+  snprintf(buf, size, "%.*s%.*s%s", (int) len, url, (int) (end - host), host, scheme ? "/" : ":");
+}
+
+static int entry_matches(cred_entry *entry, gert_cred_type type, const char *prefix,
+                         const char *scope, const char *username){
+  if(entry->type != type || strcmp(entry->prefix, prefix) || strcmp(entry->scope, scope))
+    return 0;
+  return username == NULL || (entry->cred.username && !strcmp(entry->cred.username, username));
+}
+
+/* Removes expired entries; must be called with the lock held */
+static void expire_entries(void){
+  double now = gert_time_now();
+  cred_entry **prev = &cache;
+  while(*prev){
+    cred_entry *entry = *prev;
+    if(entry->expires < now){
+      *prev = entry->next;
+      free_entry(entry);
+    } else {
+      prev = &entry->next;
+    }
+  }
+}
+
+/* Copies a cached credential into out, which must be cleared by the caller. A NULL
+ * username matches any user, which is the case for https URLs without a username. */
+int gert_cred_cache_get(gert_cred_type type, const char *url, const char *scope,
+                        const char *username, gert_cred *out){
+  char prefix[1000];
+  int found = 0;
+  url_prefix(url, prefix, sizeof(prefix));
+  pthread_mutex_lock(&lock);
+  expire_entries();
+  for(cred_entry *entry = cache; entry; entry = entry->next){
+    if(entry_matches(entry, type, prefix, scope, username)){
+      out->username = copy_string(entry->cred.username);
+      out->password = copy_string(entry->cred.password);
+      out->pubkey_path = copy_string(entry->cred.pubkey_path);
+      out->key_path = copy_string(entry->cred.key_path);
+      found = 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return found;
+}
+
+void gert_cred_cache_drop(gert_cred_type type, const char *url, const char *scope, const char *username){
+  char prefix[1000];
+  url_prefix(url, prefix, sizeof(prefix));
+  pthread_mutex_lock(&lock);
+  cred_entry **prev = &cache;
+  while(*prev){
+    cred_entry *entry = *prev;
+    if(entry_matches(entry, type, prefix, scope, username)){
+      *prev = entry->next;
+      free_entry(entry);
+    } else {
+      prev = &entry->next;
+    }
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+/* Newer entries come first, so they win lookups without a username */
+void gert_cred_cache_put(gert_cred_type type, const char *url, const char *scope, const gert_cred *cred){
+  if(cache_ttl <= 0)
+    return;
+  gert_cred_cache_drop(type, url, scope, cred->username);
+  char prefix[1000];
+  url_prefix(url, prefix, sizeof(prefix));
+  cred_entry *entry = calloc(1, sizeof(cred_entry));
+  entry->type = type;
+  entry->prefix = strdup(prefix);
+  entry->scope = strdup(scope);
+  entry->cred.username = copy_string(cred->username);
+  entry->cred.password = copy_string(cred->password);
+  entry->cred.pubkey_path = copy_string(cred->pubkey_path);
+  entry->cred.key_path = copy_string(cred->key_path);
+  pthread_mutex_lock(&lock);
+  entry->expires = gert_time_now() + cache_ttl;
+  entry->next = cache;
+  cache = entry;
+  pthread_mutex_unlock(&lock);
+}
+
+static void clear_cache(void){
+  pthread_mutex_lock(&lock);
+  while(cache){
+    cred_entry *entry = cache;
+    cache = entry->next;
+    free_entry(entry);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+SEXP R_git_credential_cache_ttl(SEXP ttl){
+  SEXP old = PROTECT(Rf_ScalarReal(cache_ttl));
+  if(Rf_length(ttl)){
+    double val = Rf_asReal(ttl);
+    if(!(val >= 0))
+      Rf_error("ttl must be a number >= 0");
+    cache_ttl = val;
+    if(cache_ttl == 0)
+      clear_cache();
+  }
+  UNPROTECT(1);
+  return old;
+}
+
+SEXP R_git_credential_cache_clear(void){
+  clear_cache();
+  return R_NilValue;
+}
+
+/* Lists the cached entries without their secrets. The entries are copied first, because
+ * the R API must not be called while holding the lock. */
+SEXP R_git_credential_cache_list(void){
+  int n = 0;
+  pthread_mutex_lock(&lock);
+  expire_entries();
+  for(cred_entry *entry = cache; entry; entry = entry->next)
+    n++;
+  cred_entry *copy = calloc(n ? n : 1, sizeof(cred_entry));
+  cred_entry *entry = cache;
+  for(int i = 0; i < n; i++, entry = entry->next){
+    copy[i].type = entry->type;
+    copy[i].prefix = strdup(entry->prefix);
+    copy[i].cred.username = copy_string(entry->cred.username);
+    copy[i].expires = entry->expires;
+  }
+  pthread_mutex_unlock(&lock);
+  double now = gert_time_now();
+  SEXP url = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP username = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP type = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP expires = PROTECT(Rf_allocVector(REALSXP, n));
+  for(int i = 0; i < n; i++){
+    SET_STRING_ELT(url, i, safe_char(copy[i].prefix));
+    SET_STRING_ELT(username, i, safe_char(copy[i].cred.username));
+    SET_STRING_ELT(type, i, safe_char(copy[i].type == GERT_CRED_SSH_KEY ? "ssh-key" : "userpass"));
+    REAL(expires)[i] = copy[i].expires - now;
+    free(copy[i].prefix);
+    free(copy[i].cred.username);
+  }
+  free(copy);
+  SEXP out = build_tibble(4, "url", url, "username", username, "type", type, "expires", expires);
+  UNPROTECT(4);
+  return out;
+}
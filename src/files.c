@@ -17,6 +17,7 @@ SEXP R_git_repository_info(SEXP ptr){
   int is_bare = git_repository_is_bare(repo);
 
   SEXP bare = PROTECT(Rf_ScalarLogical(is_bare));
+  SEXP shallow = PROTECT(Rf_ScalarLogical(git_repository_is_shallow(repo)));
   SEXP path = PROTECT(safe_string(
     is_bare ? git_repository_path(repo) : git_repository_workdir(repo)
   ));
@@ -49,9 +50,10 @@ SEXP R_git_repository_info(SEXP ptr){
     git_strarray_free(&remotes);
   }
 
-  SEXP out = build_list(8, "path", path, "bare", bare, "head", headref, "shorthand", shorthand,
-                    "commit", target, "remote", remote, "upstream", upstream, "reflist", refs);
-  UNPROTECT(8);
+  SEXP out = build_list(9, "path", path, "bare", bare, "head", headref, "shorthand", shorthand,
+                    "commit", target, "remote", remote, "upstream", upstream, "reflist", refs,
+                    "shallow", shallow);
+  UNPROTECT(9);
   return out;
 }
 
@@ -193,7 +195,30 @@ SEXP R_git_status_list(SEXP ptr, SEXP show_staged, SEXP path_spec){
     GIT_STATUS_OPT_RENAMES_HEAD_TO_INDEX |
     GIT_STATUS_OPT_SORT_CASE_SENSITIVELY;
   bail_if(git_status_list_new(&list, repo, &opts), "git_status_list_new");
-  size_t len = git_status_list_entrycount(list);
+  git_index *index = NULL;
+  if(git_repository_index(&index, repo)){
+    git_status_list_free(list);
+    bail_if(-1, "git_repository_index");
+  }
+
+  /* Like git, the working tree is not compared for entries with the skip-worktree flag,
+   * which are the tracked files outside of a sparse checkout */
+  size_t total = git_status_list_entrycount(list);
+  git_status_entry *entries = (git_status_entry *) R_alloc(total ? total : 1, sizeof(git_status_entry));
+  size_t len = 0;
+  for(size_t i = 0; i < total; i++){
+    git_status_entry entry = *git_status_byindex(list, i);
+    if(entry.index_to_workdir && !(entry.status & GIT_STATUS_WT_NEW)){
+      const git_index_entry *ie = git_index_get_bypath(index, entry.index_to_workdir->old_file.path, 0);
+      if(ie && (ie->flags_extended & GIT_INDEX_ENTRY_SKIP_WORKTREE)){
+        entry.status &= ~(GIT_STATUS_WT_MODIFIED | GIT_STATUS_WT_DELETED | GIT_STATUS_WT_TYPECHANGE |
+                          GIT_STATUS_WT_RENAMED | GIT_STATUS_WT_UNREADABLE);
+        entry.index_to_workdir = NULL;
+      }
+    }
+    if(entry.status != GIT_STATUS_CURRENT)
+      entries[len++] = entry;
+  }
   SEXP files = PROTECT(Rf_allocVector(STRSXP, len));
   SEXP statuses = PROTECT(Rf_allocVector(STRSXP, len));
   SEXP staged = PROTECT(Rf_allocVector(LGLSXP, len));
@@ -201,11 +226,12 @@ SEXP R_git_status_list(SEXP ptr, SEXP show_staged, SEXP path_spec){
     char status[100] = "";
     char filename[4000] = "";
     int isstaged = NA_LOGICAL;
-    extract_entry_data(git_status_byindex(list, i), status, filename, &isstaged);
+    extract_entry_data(&entries[i], status, filename, &isstaged);
     SET_STRING_ELT(files, i, safe_char(filename));
     SET_STRING_ELT(statuses, i, safe_char(status));
     LOGICAL(staged)[i] = isstaged;
   }
+  git_index_free(index);
   git_status_list_free(list);
   SEXP out = build_tibble(3, "file", files, "status", statuses, "staged", staged);
   UNPROTECT(3);
@@ -0,0 +1,424 @@
+#include <stdint.h>
+#include <string.h>
+#include "utils.h"
+
+/* Resolve element i of a character vector to a commit id, NA strings are not resolved */
+static int resolve_element(git_oid *out, SEXP refs, int i, git_repository *repo){
+  if(STRING_ELT(refs, i) == NA_STRING)
+    return 0;
+  SEXP ref = PROTECT(Rf_ScalarString(STRING_ELT(refs, i)));
+  git_object *obj = resolve_refish(ref, repo);
+  git_oid_cpy(out, git_object_id(obj));
+  git_object_free(obj);
+  UNPROTECT(1);
+  return 1;
+}
+
+/* Count commits reachable from 'from' but not from 'hide'. The walker keeps its
+ * parsed commit graph after a reset, so consecutive walks over overlapping
+ * history do not parse the same commits again. Errors are returned rather than
+ * raised so that the caller can free the walker first. */
+static int count_reachable(int *out, git_revwalk *walk, const git_oid *from, const git_oid *hide, int *interrupted){
+  int res;
+  int count = 0;
+  git_oid oid;
+  if((res = git_revwalk_reset(walk)) || (res = git_revwalk_push(walk, from)) ||
+     (res = git_revwalk_hide(walk, hide)))
+    return res;
+  while((res = git_revwalk_next(&oid, walk)) == 0){
+    if(++count % 10000 == 0 && gert_pending_interrupt()){
+      *interrupted = 1;
+      return 0;
+    }
+  }
+  *out = count;
+  return res == GIT_ITEROVER ? 0 : res;
+}
+
+SEXP R_git_ahead_behind_list(SEXP ptr, SEXP refs, SEXP upstreams){
+  int res = 0;
+  int interrupted = 0;
+  git_revwalk *walk = NULL;
+  git_repository *repo = get_git_repository(ptr);
+  int len = Rf_length(refs);
+  if(Rf_length(upstreams) != len)
+    Rf_error("Length of ref and upstream must be equal");
+  SEXP ahead = PROTECT(Rf_allocVector(INTSXP, len));
+  SEXP behind = PROTECT(Rf_allocVector(INTSXP, len));
+  SEXP local_ids = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP upstream_ids = PROTECT(Rf_allocVector(STRSXP, len));
+
+  /* Resolve everything before creating the walker, which would leak if resolving errors */
+  git_oid *local = (git_oid *) R_alloc(len, sizeof(git_oid));
+  git_oid *upstream = (git_oid *) R_alloc(len, sizeof(git_oid));
+  for(int i = 0; i < len; i++){
+    int has_local = resolve_element(&local[i], refs, i, repo);
+    int has_upstream = resolve_element(&upstream[i], upstreams, i, repo);
+    SET_STRING_ELT(local_ids, i, has_local ? safe_char(git_oid_tostr_s(&local[i])) : NA_STRING);
+    SET_STRING_ELT(upstream_ids, i, has_upstream ? safe_char(git_oid_tostr_s(&upstream[i])) : NA_STRING);
+    INTEGER(ahead)[i] = has_local && has_upstream ? 0 : NA_INTEGER;
+    INTEGER(behind)[i] = has_local && has_upstream ? 0 : NA_INTEGER;
+  }
+  bail_if(git_revwalk_new(&walk, repo), "git_revwalk_new");
+  git_revwalk_sorting(walk, GIT_SORT_NONE);
+  for(int i = 0; i < len && !res && !interrupted; i++){
+    if(INTEGER(ahead)[i] == NA_INTEGER || git_oid_equal(&local[i], &upstream[i]))
+      continue;
+    res = count_reachable(&INTEGER(ahead)[i], walk, &local[i], &upstream[i], &interrupted);
+    if(!res && !interrupted)
+      res = count_reachable(&INTEGER(behind)[i], walk, &upstream[i], &local[i], &interrupted);
+  }
+  git_revwalk_free(walk);
+  if(interrupted)
+    Rf_error("Ahead/behind count was interrupted by the user");
+  bail_if(res, "git_revwalk");
+  SEXP out = build_tibble(6, "ref", refs, "upstream", upstreams, "ahead", ahead, "behind", behind,
+                          "local", local_ids, "remote", upstream_ids);
+  UNPROTECT(4);
+  return out;
+}
+
+typedef struct {
+  git_oid id;
+  int index;
+} graph_query;
+
+static int query_cmp(const void *a, const void *b){
+  return git_oid_cmp(&((const graph_query *) a)->id, &((const graph_query *) b)->id);
+}
+
+/* Resolve all queries into an array sorted by oid. Unresolvable (NA) inputs are skipped. */
+static graph_query *sorted_queries(SEXP commits, git_repository *repo, int *n){
+  int len = Rf_length(commits);
+  graph_query *queries = (graph_query *) R_alloc(len, sizeof(graph_query));
+  *n = 0;
+  for(int i = 0; i < len; i++){
+    if(resolve_element(&queries[*n].id, commits, i, repo))
+      queries[(*n)++].index = i;
+  }
+  qsort(queries, *n, sizeof(graph_query), query_cmp);
+  return queries;
+}
+
+/* Walk the ancestry of 'tip' a single time and mark every query that is reached.
+ * The tip itself is not counted, consistent with git_graph_descendant_of(). The
+ * walk stops as soon as all queries have been found. */
+static void mark_reachable(git_repository *repo, const git_oid *tip, graph_query *queries, int n, int *found){
+  int res;
+  int todo = n;
+  size_t count = 0;
+  git_oid oid;
+  git_revwalk *walk = NULL;
+  for(int i = 0; i < n; i++){
+    if(git_oid_equal(&queries[i].id, tip))
+      todo--;
+  }
+  if(todo == 0)
+    return;
+  bail_if(git_revwalk_new(&walk, repo), "git_revwalk_new");
+  git_revwalk_sorting(walk, GIT_SORT_NONE);
+  if((res = git_revwalk_push(walk, tip))){
+    git_revwalk_free(walk);
+    bail_if(res, "git_revwalk_push");
+  }
+  while(todo > 0 && (res = git_revwalk_next(&oid, walk)) == 0){
+    if(++count % 10000 == 0 && gert_pending_interrupt()){
+      git_revwalk_free(walk);
+      Rf_error("Commit graph walk was interrupted by the user");
+    }
+    if(git_oid_equal(&oid, tip))
+      continue;
+    graph_query key;
+    git_oid_cpy(&key.id, &oid);
+    graph_query *hit = bsearch(&key, queries, n, sizeof(graph_query), query_cmp);
+    if(hit == NULL)
+      continue;
+    /* Duplicate inputs are adjacent after sorting */
+    while(hit > queries && git_oid_equal(&(hit - 1)->id, &oid))
+      hit--;
+    for(; hit < queries + n && git_oid_equal(&hit->id, &oid); hit++){
+      found[hit->index] = 1;
+      todo--;
+    }
+  }
+  git_revwalk_free(walk);
+  if(res && res != GIT_ITEROVER)
+    bail_if(res, "git_revwalk_next");
+}
+
+SEXP R_git_commit_descendant_list(SEXP ptr, SEXP ref, SEXP ancestors){
+  int n = 0;
+  int len = Rf_length(ancestors);
+  git_oid tip_id;
+  git_repository *repo = get_git_repository(ptr);
+  graph_query *queries = sorted_queries(ancestors, repo, &n);
+  git_object *tip = resolve_refish(ref, repo);
+  git_oid_cpy(&tip_id, git_object_id(tip));
+  git_object_free(tip);
+  int *found = (int *) R_alloc(len, sizeof(int));
+  memset(found, 0, len * sizeof(int));
+  mark_reachable(repo, &tip_id, queries, n, found);
+  SEXP out = PROTECT(Rf_allocVector(LGLSXP, len));
+  for(int i = 0; i < len; i++)
+    LOGICAL(out)[i] = STRING_ELT(ancestors, i) == NA_STRING ? NA_LOGICAL : found[i];
+  UNPROTECT(1);
+  return out;
+}
+
+SEXP R_git_merge_find_base_list(SEXP ptr, SEXP refs, SEXP target){
+  int n = 0;
+  int len = Rf_length(refs);
+  git_oid target_id;
+  const git_oid *tip_id = &target_id;
+  git_repository *repo = get_git_repository(ptr);
+  graph_query *queries = sorted_queries(refs, repo, &n);
+  git_object *tip = resolve_refish(target, repo);
+  git_oid_cpy(&target_id, git_object_id(tip));
+  git_object_free(tip);
+  int *found = (int *) R_alloc(len, sizeof(int));
+  memset(found, 0, len * sizeof(int));
+
+  /* Refs that are ancestors of the target are their own merge base, which covers the
+   * common case of already merged branches without a separate merge-base search */
+  mark_reachable(repo, tip_id, queries, n, found);
+  SEXP out = PROTECT(Rf_allocVector(STRSXP, len));
+  for(int i = 0; i < len; i++)
+    SET_STRING_ELT(out, i, NA_STRING);
+  for(int i = 0; i < n; i++){
+    git_oid base = {{0}};
+    const git_oid *id = &queries[i].id;
+    if(i > 0 && git_oid_equal(id, &queries[i-1].id)){
+      SET_STRING_ELT(out, queries[i].index, STRING_ELT(out, queries[i-1].index));
+      continue;
+    }
+    if(found[queries[i].index] || git_oid_equal(id, tip_id)){
+      git_oid_cpy(&base, id);
+    } else {
+      int res = git_merge_base(&base, repo, id, tip_id);
+      if(res == GIT_ENOTFOUND)
+        continue;
+      bail_if(res, "git_merge_base");
+    }
+    SET_STRING_ELT(out, queries[i].index, safe_char(git_oid_tostr_s(&base)));
+  }
+  UNPROTECT(1);
+  return out;
+}
+
+SEXP R_git_merge_bases_many(SEXP ptr, SEXP refs){
+  git_oidarray bases = {0};
+  git_repository *repo = get_git_repository(ptr);
+  int len = Rf_length(refs);
+  if(len < 2)
+    Rf_error("Need at least two refs to find merge bases");
+  git_oid *ids = (git_oid *) R_alloc(len, sizeof(git_oid));
+  for(int i = 0; i < len; i++){
+    if(!resolve_element(&ids[i], refs, i, repo))
+      Rf_error("Missing value in refs");
+  }
+  int res = git_merge_bases_many(&bases, repo, len, ids);
+  if(res == GIT_ENOTFOUND)
+    return Rf_allocVector(STRSXP, 0);
+  bail_if(res, "git_merge_bases_many");
+  SEXP out = PROTECT(Rf_allocVector(STRSXP, bases.count));
+  for(size_t i = 0; i < bases.count; i++)
+    SET_STRING_ELT(out, i, safe_char(git_oid_tostr_s(&bases.ids[i])));
+  git_oidarray_free(&bases);
+  UNPROTECT(1);
+  return out;
+}
+
+/* Reachability index: every commit in the history of the refs gets a bitset with one
+ * bit per ref that can reach it. Commits are visited in topological order, so all
+ * children of a commit are done before we visit it and its bitset is complete. At that
+ * point the bits are passed on to the parents and the bitset of the commit is freed,
+ * hence only the frontier of the walk is kept in memory. */
+typedef struct {
+  git_oid id;
+  uint64_t *bits;
+  int used;
+} reach_node;
+
+typedef struct {
+  reach_node *nodes;
+  size_t size;
+  size_t count;
+  size_t words;
+} reach_table;
+
+static size_t reach_home(reach_table *table, const git_oid *id){
+  size_t hash = 0;
+  memcpy(&hash, id->id, sizeof(hash));
+  return hash & (table->size - 1);
+}
+
+static size_t reach_slot(reach_table *table, const git_oid *id){
+  size_t i = reach_home(table, id);
+  while(table->nodes[i].used && !git_oid_equal(&table->nodes[i].id, id))
+    i = (i + 1) & (table->size - 1);
+  return i;
+}
+
+static void reach_free(reach_table *table){
+  for(size_t i = 0; i < table->size; i++)
+    free(table->nodes[i].bits);
+  free(table->nodes);
+  table->nodes = NULL;
+}
+
+/* Returns the bitset for a commit, adding it to the table if needed */
+static uint64_t *reach_bits(reach_table *table, const git_oid *id){
+  if(2 * (table->count + 1) > table->size){
+    reach_table bigger = {calloc(2 * table->size, sizeof(reach_node)), 2 * table->size, 0, table->words};
+    for(size_t i = 0; i < table->size; i++){
+      if(table->nodes[i].used)
+        bigger.nodes[reach_slot(&bigger, &table->nodes[i].id)] = table->nodes[i];
+    }
+    bigger.count = table->count;
+    free(table->nodes);
+    *table = bigger;
+  }
+  size_t i = reach_slot(table, id);
+  reach_node *node = &table->nodes[i];
+  if(!node->used){
+    node->used = 1;
+    git_oid_cpy(&node->id, id);
+    node->bits = calloc(table->words, sizeof(uint64_t));
+    table->count++;
+  }
+  return node->bits;
+}
+
+/* Drops a commit from the table once its bits were passed on to the parents. The
+ * entries after it in the same probe sequence are shifted back into the gap, so
+ * lookups never stop early and the table only holds the frontier of the walk. */
+static void reach_done(reach_table *table, const git_oid *id){
+  size_t mask = table->size - 1;
+  size_t i = reach_slot(table, id);
+  if(!table->nodes[i].used)
+    return;
+  free(table->nodes[i].bits);
+  memset(&table->nodes[i], 0, sizeof(reach_node));
+  table->count--;
+  for(size_t j = (i + 1) & mask; table->nodes[j].used; j = (j + 1) & mask){
+    size_t home = reach_home(table, &table->nodes[j].id);
+    if(((j - home) & mask) >= ((j - i) & mask)){
+      table->nodes[i] = table->nodes[j];
+      memset(&table->nodes[j], 0, sizeof(reach_node));
+      i = j;
+    }
+  }
+}
+
+SEXP R_git_reference_contains(SEXP ptr, SEXP commits, SEXP glob){
+  int res = 0;
+  int n = 0;
+  int interrupted = 0;
+  const char *what = "git_revwalk_new";
+  size_t nrefs = 0;
+  size_t count = 0;
+  git_oid oid;
+  git_commit *commit = NULL;
+  git_revwalk *walk = NULL;
+  git_repository *repo = get_git_repository(ptr);
+  const char *cglob = Rf_length(glob) ? CHAR(STRING_ELT(glob, 0)) : NULL;
+  graph_query *queries = sorted_queries(commits, repo, &n);
+  git_reference **refs = collect_references(repo, cglob, &nrefs);
+
+  /* Refs that do not point to a commit can not contain anything */
+  size_t ncols = 0;
+  git_oid *tips = (git_oid *) R_alloc(nrefs + 1, sizeof(git_oid));
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, nrefs));
+  for(size_t i = 0; i < nrefs; i++){
+    git_object *obj = NULL;
+    if(git_reference_peel(&obj, refs[i], GIT_OBJECT_COMMIT) == GIT_OK){
+      git_oid_cpy(&tips[ncols], git_object_id(obj));
+      SET_STRING_ELT(names, ncols++, safe_char(git_reference_name(refs[i])));
+      git_object_free(obj);
+    }
+    git_reference_free(refs[i]);
+  }
+  free(refs);
+  SEXP colnames = PROTECT(Rf_lengthgets(names, ncols));
+
+  int len = Rf_length(commits);
+  SEXP out = PROTECT(Rf_allocMatrix(LGLSXP, len, ncols));
+  for(R_xlen_t i = 0; i < Rf_xlength(out); i++)
+    LOGICAL(out)[i] = FALSE;
+  for(int i = 0; i < len; i++){
+    if(STRING_ELT(commits, i) == NA_STRING){
+      for(size_t j = 0; j < ncols; j++)
+        LOGICAL(out)[i + j * len] = NA_LOGICAL;
+    }
+  }
+
+  /* The walk can stop once every distinct query commit has been visited */
+  int todo = 0;
+  for(int i = 0; i < n; i++){
+    if(i == 0 || !git_oid_equal(&queries[i].id, &queries[i-1].id))
+      todo++;
+  }
+  if(ncols == 0)
+    todo = 0;
+
+  reach_table table = {calloc(1024, sizeof(reach_node)), 1024, 0, (ncols + 63) / 64};
+  if(todo == 0)
+    goto cleanup;
+  if((res = git_revwalk_new(&walk, repo)))
+    goto cleanup;
+  git_revwalk_sorting(walk, GIT_SORT_TOPOLOGICAL);
+  what = "git_revwalk_push";
+  for(size_t j = 0; j < ncols; j++){
+    reach_bits(&table, &tips[j])[j / 64] |= (uint64_t) 1 << (j % 64);
+    if((res = git_revwalk_push(walk, &tips[j])))
+      goto cleanup;
+  }
+  what = "git_revwalk_next";
+  while((res = git_revwalk_next(&oid, walk)) == 0){
+    if(++count % 10000 == 0 && gert_pending_interrupt()){
+      interrupted = 1;
+      break;
+    }
+    uint64_t *bits = reach_bits(&table, &oid);
+    graph_query key;
+    git_oid_cpy(&key.id, &oid);
+    graph_query *hit = bsearch(&key, queries, n, sizeof(graph_query), query_cmp);
+    if(hit){
+      while(hit > queries && git_oid_equal(&(hit - 1)->id, &oid))
+        hit--;
+      for(; hit < queries + n && git_oid_equal(&hit->id, &oid); hit++){
+        for(size_t j = 0; j < ncols; j++)
+          LOGICAL(out)[hit->index + j * len] = (bits[j / 64] >> (j % 64)) & 1;
+      }
+      if(--todo == 0)
+        break;
+    }
+    if((res = git_commit_lookup(&commit, repo, &oid))){
+      what = "git_commit_lookup";
+      goto cleanup;
+    }
+    unsigned int nparents = git_commit_parentcount(commit);
+    for(unsigned int p = 0; p < nparents; p++){
+      uint64_t *parent = reach_bits(&table, git_commit_parent_id(commit, p));
+      for(size_t w = 0; w < table.words; w++)
+        parent[w] |= bits[w];
+    }
+    git_commit_free(commit);
+    reach_done(&table, &oid);
+  }
+  if(res == GIT_ITEROVER)
+    res = 0;
+
+cleanup:
+  git_revwalk_free(walk);
+  reach_free(&table);
+  if(interrupted)
+    Rf_error("Reference lookup was interrupted by the user");
+  bail_if(res, what);
+  SEXP dimnames = PROTECT(Rf_allocVector(VECSXP, 2));
+  SET_VECTOR_ELT(dimnames, 0, commits);
+  SET_VECTOR_ELT(dimnames, 1, colnames);
+  Rf_setAttrib(out, R_DimNamesSymbol, dimnames);
+  UNPROTECT(4);
+  return out;
+}
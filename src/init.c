@@ -14,6 +14,13 @@
 
 /* .Call calls */
 extern SEXP R_git_ahead_behind(SEXP, SEXP, SEXP);
+extern SEXP R_git_ahead_behind_list(SEXP, SEXP, SEXP);
+extern SEXP R_git_async_cancel(SEXP);
+extern SEXP R_git_async_clone(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP R_git_async_fetch(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP R_git_async_push(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP R_git_async_result(SEXP);
+extern SEXP R_git_async_status(SEXP);
 extern SEXP R_git_branch_current(SEXP);
 extern SEXP R_git_branch_exists(SEXP, SEXP, SEXP);
 extern SEXP R_git_branch_list(SEXP, SEXP);
@@ -21,10 +28,15 @@ extern SEXP R_git_branch_move(SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_branch_set_target(SEXP, SEXP);
 extern SEXP R_git_branch_set_upstream(SEXP, SEXP, SEXP);
 extern SEXP R_git_checkout_branch(SEXP, SEXP, SEXP);
+extern SEXP R_git_checkout_export(SEXP, SEXP, SEXP);
+extern SEXP R_git_checkout_parallel(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP R_git_checkout_plan(SEXP, SEXP, SEXP);
 extern SEXP R_git_checkout_unborn(SEXP, SEXP);
 extern SEXP R_git_cherry_pick(SEXP, SEXP);
+extern SEXP R_git_cherry_pick_range(SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_commit_create(SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_commit_descendant(SEXP, SEXP, SEXP);
+extern SEXP R_git_commit_descendant_list(SEXP, SEXP, SEXP);
 extern SEXP R_git_commit_id(SEXP, SEXP);
 extern SEXP R_git_commit_info(SEXP, SEXP);
 extern SEXP R_git_commit_log(SEXP, SEXP, SEXP, SEXP, SEXP);
@@ -32,55 +44,81 @@ extern SEXP R_git_commit_stats(SEXP, SEXP);
 extern SEXP R_git_config_list(SEXP);
 extern SEXP R_git_config_set(SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_config_unset(SEXP, SEXP, SEXP);
-extern SEXP R_git_conflict_list(SEXP);
+extern SEXP R_git_conflict_list(SEXP, SEXP, SEXP);
+extern SEXP R_git_conflict_resolve(SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_create_branch(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP R_git_credential_cache_clear(void);
+extern SEXP R_git_credential_cache_list(void);
+extern SEXP R_git_credential_cache_ttl(SEXP);
 extern SEXP R_git_delete_branch(SEXP, SEXP);
 extern SEXP R_git_diff_list(SEXP, SEXP);
 extern SEXP R_git_ignore_path_is_ignored(SEXP ptr, SEXP path);
+extern SEXP R_git_local_depth(SEXP, SEXP);
 extern SEXP R_git_merge_analysis(SEXP, SEXP);
+extern SEXP R_git_merge_bases_many(SEXP, SEXP);
 extern SEXP R_git_merge_cleanup(SEXP);
 extern SEXP R_git_merge_find_base(SEXP, SEXP, SEXP);
+extern SEXP R_git_merge_octopus(SEXP, SEXP, SEXP);
+extern SEXP R_git_merge_find_base_list(SEXP, SEXP, SEXP);
 extern SEXP R_git_merge_parent_heads(SEXP);
 extern SEXP R_git_merge_stage(SEXP, SEXP);
+extern SEXP R_git_merge_simulate(SEXP, SEXP, SEXP);
 extern SEXP R_git_rebase(SEXP, SEXP, SEXP);
+extern SEXP R_git_rebase_inmemory(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP R_git_reference_contains(SEXP, SEXP, SEXP);
+extern SEXP R_git_reference_list(SEXP, SEXP);
+extern SEXP R_git_reflog_list(SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_remote_add(SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_remote_add_fetch(SEXP, SEXP, SEXP);
-extern SEXP R_git_remote_fetch(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP R_git_remote_fetch(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP R_git_remote_fetch_many(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_remote_info(SEXP, SEXP);
 extern SEXP R_git_remote_list(SEXP);
 extern SEXP R_git_remote_ls(SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_remote_push(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_remote_refspecs(SEXP, SEXP);
 extern SEXP R_git_remote_remove(SEXP, SEXP);
+extern SEXP R_git_remote_session(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP R_git_remote_session_close(SEXP);
+extern SEXP R_git_remote_session_fetch(SEXP, SEXP, SEXP);
+extern SEXP R_git_remote_session_info(SEXP);
+extern SEXP R_git_remote_session_ls(SEXP, SEXP);
+extern SEXP R_git_remote_session_push(SEXP, SEXP);
 extern SEXP R_git_remote_set_url(SEXP, SEXP, SEXP);
 extern SEXP R_git_restore(SEXP, SEXP, SEXP);
 extern SEXP R_git_revert(SEXP, SEXP);
 extern SEXP R_git_repository_add(SEXP, SEXP, SEXP);
-extern SEXP R_git_repository_clone(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP R_git_repository_clone(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_repository_find(SEXP);
 extern SEXP R_git_repository_info(SEXP);
-extern SEXP R_git_repository_init(SEXP, SEXP);
+extern SEXP R_git_repository_init(SEXP, SEXP, SEXP);
 extern SEXP R_git_repository_ls(SEXP, SEXP);
-extern SEXP R_git_repository_open(SEXP, SEXP);
+extern SEXP R_git_repository_open(SEXP, SEXP, SEXP);
 extern SEXP R_git_repository_path(SEXP);
 extern SEXP R_git_repository_rm(SEXP, SEXP);
 extern SEXP R_git_reset(SEXP, SEXP, SEXP);
 extern SEXP R_git_signature_create(SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_signature_default(SEXP);
 extern SEXP R_git_signature_parse(SEXP);
+extern SEXP R_git_sparse_checkout_disable(SEXP);
+extern SEXP R_git_sparse_checkout_list(SEXP);
+extern SEXP R_git_sparse_checkout_set(SEXP, SEXP);
+extern SEXP R_git_stash_apply(SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_stash_drop(SEXP, SEXP);
 extern SEXP R_git_stash_list(SEXP);
-extern SEXP R_git_stash_pop(SEXP, SEXP);
 extern SEXP R_git_stash_save(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP R_git_stash_show(SEXP, SEXP, SEXP);
 extern SEXP R_git_stat_files(SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_status_list(SEXP, SEXP, SEXP);
 extern SEXP R_git_submodule_info(SEXP, SEXP);
+extern SEXP R_git_submodule_cache(SEXP, SEXP);
 extern SEXP R_git_submodule_init(SEXP, SEXP, SEXP);
-extern SEXP R_git_submodule_list(SEXP);
+extern SEXP R_git_submodule_list(SEXP, SEXP);
 extern SEXP R_git_submodule_save(SEXP, SEXP);
 extern SEXP R_git_submodule_set_to(SEXP, SEXP, SEXP);
 extern SEXP R_git_submodule_setup(SEXP, SEXP, SEXP);
 extern SEXP R_git_submodule_update(SEXP, SEXP, SEXP);
+extern SEXP R_git_submodule_update_many(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_tag_create(SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_tag_delete(SEXP, SEXP);
 extern SEXP R_git_tag_list(SEXP, SEXP);
@@ -94,12 +132,20 @@ extern SEXP R_git_worktree_unlock(SEXP, SEXP);
 extern SEXP R_git_worktree_add(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_worktree_is_prunable(SEXP, SEXP, SEXP, SEXP);
 extern SEXP R_git_worktree_prune(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP R_git_worktree_status(SEXP, SEXP, SEXP);
 extern SEXP R_libgit2_config(void);
 extern SEXP R_set_cert_locations(SEXP, SEXP);
 extern SEXP R_static_libgit2(void);
 
 static const R_CallMethodDef CallEntries[] = {
   {"R_git_ahead_behind",        (DL_FUNC) &R_git_ahead_behind,        3},
+  {"R_git_ahead_behind_list",   (DL_FUNC) &R_git_ahead_behind_list,   3},
+  {"R_git_async_cancel",        (DL_FUNC) &R_git_async_cancel,        1},
+  {"R_git_async_clone",         (DL_FUNC) &R_git_async_clone,         9},
+  {"R_git_async_fetch",         (DL_FUNC) &R_git_async_fetch,         7},
+  {"R_git_async_push",          (DL_FUNC) &R_git_async_push,          6},
+  {"R_git_async_result",        (DL_FUNC) &R_git_async_result,        1},
+  {"R_git_async_status",        (DL_FUNC) &R_git_async_status,        1},
   {"R_git_branch_current",      (DL_FUNC) &R_git_branch_current,      1},
   {"R_git_branch_exists",       (DL_FUNC) &R_git_branch_exists,       3},
   {"R_git_branch_list",         (DL_FUNC) &R_git_branch_list,         2},
@@ -107,10 +153,15 @@ static const R_CallMethodDef CallEntries[] = {
   {"R_git_branch_set_target",   (DL_FUNC) &R_git_branch_set_target,   2},
   {"R_git_branch_set_upstream", (DL_FUNC) &R_git_branch_set_upstream, 3},
   {"R_git_checkout_branch",     (DL_FUNC) &R_git_checkout_branch,     3},
+  {"R_git_checkout_export",     (DL_FUNC) &R_git_checkout_export,     3},
+  {"R_git_checkout_parallel",   (DL_FUNC) &R_git_checkout_parallel,   5},
+  {"R_git_checkout_plan",       (DL_FUNC) &R_git_checkout_plan,       3},
   {"R_git_checkout_unborn",     (DL_FUNC) &R_git_checkout_unborn,     2},
   {"R_git_cherry_pick",         (DL_FUNC) &R_git_cherry_pick,         2},
+  {"R_git_cherry_pick_range",   (DL_FUNC) &R_git_cherry_pick_range,   4},
   {"R_git_commit_create",       (DL_FUNC) &R_git_commit_create,       5},
   {"R_git_commit_descendant",   (DL_FUNC) &R_git_commit_descendant,   3},
+  {"R_git_commit_descendant_list", (DL_FUNC) &R_git_commit_descendant_list, 3},
   {"R_git_commit_id",           (DL_FUNC) &R_git_commit_id,           2},
   {"R_git_commit_info",         (DL_FUNC) &R_git_commit_info,         2},
   {"R_git_commit_log",          (DL_FUNC) &R_git_commit_log,          5},
@@ -118,34 +169,54 @@ static const R_CallMethodDef CallEntries[] = {
   {"R_git_config_list",         (DL_FUNC) &R_git_config_list,         1},
   {"R_git_config_set",          (DL_FUNC) &R_git_config_set,          4},
   {"R_git_config_unset",        (DL_FUNC) &R_git_config_unset,        3},
-  {"R_git_conflict_list",       (DL_FUNC) &R_git_conflict_list,       1},
+  {"R_git_conflict_list",       (DL_FUNC) &R_git_conflict_list,       3},
+  {"R_git_conflict_resolve",    (DL_FUNC) &R_git_conflict_resolve,    5},
   {"R_git_create_branch",       (DL_FUNC) &R_git_create_branch,       5},
+  {"R_git_credential_cache_clear", (DL_FUNC) &R_git_credential_cache_clear, 0},
+  {"R_git_credential_cache_list", (DL_FUNC) &R_git_credential_cache_list, 0},
+  {"R_git_credential_cache_ttl", (DL_FUNC) &R_git_credential_cache_ttl, 1},
   {"R_git_delete_branch",       (DL_FUNC) &R_git_delete_branch,       2},
   {"R_git_diff_list",           (DL_FUNC) &R_git_diff_list,           2},
   {"R_git_ignore_path_is_ignored", (DL_FUNC) &R_git_ignore_path_is_ignored, 2},
+  {"R_git_local_depth",         (DL_FUNC) &R_git_local_depth,         2},
   {"R_git_merge_analysis",      (DL_FUNC) &R_git_merge_analysis,      2},
+  {"R_git_merge_bases_many",    (DL_FUNC) &R_git_merge_bases_many,    2},
   {"R_git_merge_cleanup",       (DL_FUNC) &R_git_merge_cleanup,       1},
   {"R_git_merge_find_base",     (DL_FUNC) &R_git_merge_find_base,     3},
+  {"R_git_merge_octopus",       (DL_FUNC) &R_git_merge_octopus,       3},
+  {"R_git_merge_find_base_list", (DL_FUNC) &R_git_merge_find_base_list, 3},
   {"R_git_merge_parent_heads",  (DL_FUNC) &R_git_merge_parent_heads,  1},
   {"R_git_merge_stage",         (DL_FUNC) &R_git_merge_stage,         2},
+  {"R_git_merge_simulate",      (DL_FUNC) &R_git_merge_simulate,      3},
   {"R_git_rebase",              (DL_FUNC) &R_git_rebase,              3},
+  {"R_git_rebase_inmemory",     (DL_FUNC) &R_git_rebase_inmemory,     5},
+  {"R_git_reference_contains",  (DL_FUNC) &R_git_reference_contains,  3},
+  {"R_git_reference_list",      (DL_FUNC) &R_git_reference_list,      2},
+  {"R_git_reflog_list",         (DL_FUNC) &R_git_reflog_list,         4},
   {"R_git_remote_add",          (DL_FUNC) &R_git_remote_add,          4},
   {"R_git_remote_add_fetch",    (DL_FUNC) &R_git_remote_add_fetch,    3},
-  {"R_git_remote_fetch",        (DL_FUNC) &R_git_remote_fetch,        7},
+  {"R_git_remote_fetch",        (DL_FUNC) &R_git_remote_fetch,        9},
+  {"R_git_remote_fetch_many",   (DL_FUNC) &R_git_remote_fetch_many,   8},
   {"R_git_remote_info",         (DL_FUNC) &R_git_remote_info,         2},
   {"R_git_remote_list",         (DL_FUNC) &R_git_remote_list,         1},
   {"R_git_remote_ls",           (DL_FUNC) &R_git_remote_ls,           5},
   {"R_git_remote_push",         (DL_FUNC) &R_git_remote_push,         6},
   {"R_git_remote_refspecs",     (DL_FUNC) &R_git_remote_refspecs,     2},
   {"R_git_remote_remove",       (DL_FUNC) &R_git_remote_remove,       2},
+  {"R_git_remote_session",      (DL_FUNC) &R_git_remote_session,      5},
+  {"R_git_remote_session_close", (DL_FUNC) &R_git_remote_session_close, 1},
+  {"R_git_remote_session_fetch", (DL_FUNC) &R_git_remote_session_fetch, 3},
+  {"R_git_remote_session_info", (DL_FUNC) &R_git_remote_session_info, 1},
+  {"R_git_remote_session_ls",   (DL_FUNC) &R_git_remote_session_ls,   2},
+  {"R_git_remote_session_push", (DL_FUNC) &R_git_remote_session_push, 2},
   {"R_git_remote_set_url",      (DL_FUNC) &R_git_remote_set_url,      3},
   {"R_git_repository_add",      (DL_FUNC) &R_git_repository_add,      3},
-  {"R_git_repository_clone",    (DL_FUNC) &R_git_repository_clone,    9},
+  {"R_git_repository_clone",    (DL_FUNC) &R_git_repository_clone,    14},
   {"R_git_repository_find",     (DL_FUNC) &R_git_repository_find,     1},
   {"R_git_repository_info",     (DL_FUNC) &R_git_repository_info,     1},
-  {"R_git_repository_init",     (DL_FUNC) &R_git_repository_init,     2},
+  {"R_git_repository_init",     (DL_FUNC) &R_git_repository_init,     3},
   {"R_git_repository_ls",       (DL_FUNC) &R_git_repository_ls,       2},
-  {"R_git_repository_open",     (DL_FUNC) &R_git_repository_open,     2},
+  {"R_git_repository_open",     (DL_FUNC) &R_git_repository_open,     3},
   {"R_git_repository_path",     (DL_FUNC) &R_git_repository_path,     1},
   {"R_git_repository_rm",       (DL_FUNC) &R_git_repository_rm,       2},
   {"R_git_reset",               (DL_FUNC) &R_git_reset,               3},
@@ -154,19 +225,25 @@ static const R_CallMethodDef CallEntries[] = {
   {"R_git_signature_create",    (DL_FUNC) &R_git_signature_create,    4},
   {"R_git_signature_default",   (DL_FUNC) &R_git_signature_default,   1},
   {"R_git_signature_parse",     (DL_FUNC) &R_git_signature_parse,     1},
+  {"R_git_sparse_checkout_disable", (DL_FUNC) &R_git_sparse_checkout_disable, 1},
+  {"R_git_sparse_checkout_list", (DL_FUNC) &R_git_sparse_checkout_list, 1},
+  {"R_git_sparse_checkout_set", (DL_FUNC) &R_git_sparse_checkout_set, 2},
+  {"R_git_stash_apply",         (DL_FUNC) &R_git_stash_apply,         5},
   {"R_git_stash_drop",          (DL_FUNC) &R_git_stash_drop,          2},
   {"R_git_stash_list",          (DL_FUNC) &R_git_stash_list,          1},
-  {"R_git_stash_pop",           (DL_FUNC) &R_git_stash_pop,           2},
   {"R_git_stash_save",          (DL_FUNC) &R_git_stash_save,          5},
+  {"R_git_stash_show",          (DL_FUNC) &R_git_stash_show,          3},
   {"R_git_stat_files",          (DL_FUNC) &R_git_stat_files,          4},
   {"R_git_status_list",         (DL_FUNC) &R_git_status_list,         3},
   {"R_git_submodule_info",      (DL_FUNC) &R_git_submodule_info,      2},
+  {"R_git_submodule_cache",     (DL_FUNC) &R_git_submodule_cache,     2},
   {"R_git_submodule_init",      (DL_FUNC) &R_git_submodule_init,      3},
-  {"R_git_submodule_list",      (DL_FUNC) &R_git_submodule_list,      1},
+  {"R_git_submodule_list",      (DL_FUNC) &R_git_submodule_list,      2},
   {"R_git_submodule_save",      (DL_FUNC) &R_git_submodule_save,      2},
   {"R_git_submodule_set_to",    (DL_FUNC) &R_git_submodule_set_to,    3},
   {"R_git_submodule_setup",     (DL_FUNC) &R_git_submodule_setup,     3},
   {"R_git_submodule_update",    (DL_FUNC) &R_git_submodule_update,    3},
+  {"R_git_submodule_update_many", (DL_FUNC) &R_git_submodule_update_many, 7},
   {"R_git_tag_create",          (DL_FUNC) &R_git_tag_create,          4},
   {"R_git_tag_delete",          (DL_FUNC) &R_git_tag_delete,          2},
   {"R_git_tag_list",            (DL_FUNC) &R_git_tag_list,            2},
@@ -180,14 +257,18 @@ static const R_CallMethodDef CallEntries[] = {
   {"R_git_worktree_add",        (DL_FUNC) &R_git_worktree_add,        6},
   {"R_git_worktree_is_prunable",(DL_FUNC) &R_git_worktree_is_prunable,4},
   {"R_git_worktree_prune",      (DL_FUNC) &R_git_worktree_prune,      5},
+  {"R_git_worktree_status",     (DL_FUNC) &R_git_worktree_status,     3},
   {"R_libgit2_config",          (DL_FUNC) &R_libgit2_config,          0},
   {"R_set_cert_locations",      (DL_FUNC) &R_set_cert_locations,      2},
   {"R_static_libgit2",          (DL_FUNC) &R_static_libgit2,          0},
   {NULL, NULL, 0}
 };
 
+extern void gert_parallel_init(void);
+
 attribute_visible void R_init_gert(DllInfo *dll) {
   git_libgit2_init();
+  gert_parallel_init();
 #ifdef _WIN32
   char homedir[8000] = {0};
   const char *userprofile = getenv("USERPROFILE");
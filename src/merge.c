@@ -8,8 +8,10 @@ SEXP R_git_branch_set_target(SEXP ptr, SEXP ref){
   git_repository *repo = get_git_repository(ptr);
   git_object *revision = resolve_refish(ref, repo);
   git_checkout_options opts = GIT_CHECKOUT_OPTIONS_INIT;
+  set_checkout_sparse(&opts, repo);
   bail_if(git_repository_head(&head, repo), "git_repository_head");
   bail_if(git_checkout_tree(repo, revision, &opts), "git_checkout_tree");
+  sparse_checkout_sync(repo, revision);
   bail_if(git_reference_set_target(&out_target, head, git_object_id(revision), NULL), "git_reference_set_target");
   git_reference_free(out_target);
   git_reference_free(head);
@@ -97,6 +99,55 @@ SEXP R_git_merge_stage(SEXP ptr, SEXP refs){
   return Rf_ScalarLogical(conflicted == 0);
 }
 
+static git_commit *lookup_commit(git_repository *repo, SEXP ref){
+  git_object *revision = resolve_refish(PROTECT(Rf_ScalarString(ref)), repo);
+  UNPROTECT(1);
+  return (git_commit *) revision;
+}
+
+/* Merges each pair of commits into an in-memory index, without touching the index or
+ * working tree of the repository. Clean merges are written to the odb as a tree, which
+ * is what a merge commit would contain. The target commit is reused for consecutive
+ * pairs, which is the common case of many branches against a single target. */
+SEXP R_git_merge_simulate(SEXP ptr, SEXP refs, SEXP targets){
+  int len = Rf_length(refs);
+  git_commit *target = NULL;
+  git_repository *repo = get_git_repository(ptr);
+  git_merge_options opts = GIT_MERGE_OPTIONS_INIT;
+  opts.flags |= GIT_MERGE_SKIP_REUC;
+  SEXP clean = PROTECT(Rf_allocVector(LGLSXP, len));
+  SEXP trees = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP conflicts = PROTECT(Rf_allocVector(VECSXP, len));
+  for(int i = 0; i < len; i++){
+    if(i == 0 || strcmp(CHAR(STRING_ELT(targets, i)), CHAR(STRING_ELT(targets, i - 1)))){
+      git_commit_free(target);
+      target = lookup_commit(repo, STRING_ELT(targets, i));
+    }
+    git_index *index = NULL;
+    git_commit *commit = lookup_commit(repo, STRING_ELT(refs, i));
+    int res = git_merge_commits(&index, repo, target, commit, &opts);
+    git_commit_free(commit);
+    bail_if(res, "git_merge_commits");
+    if(git_index_has_conflicts(index)){
+      LOGICAL(clean)[i] = FALSE;
+      SET_STRING_ELT(trees, i, NA_STRING);
+      SET_VECTOR_ELT(conflicts, i, conflict_paths(index));
+    } else {
+      git_oid tree_id = {{0}};
+      bail_if(git_index_write_tree_to(&tree_id, index, repo), "git_index_write_tree_to");
+      LOGICAL(clean)[i] = TRUE;
+      SET_STRING_ELT(trees, i, safe_char(git_oid_tostr_s(&tree_id)));
+      SET_VECTOR_ELT(conflicts, i, Rf_allocVector(STRSXP, 0));
+    }
+    git_index_free(index);
+  }
+  git_commit_free(target);
+  SEXP out = build_tibble(5, "ref", refs, "target", targets, "clean", clean, "tree", trees,
+                          "conflicts", conflicts);
+  UNPROTECT(3);
+  return out;
+}
+
 /* Need to call cleanup both after committing or aborting a merge state */
 SEXP R_git_merge_cleanup(SEXP ptr){
   git_repository *repo = get_git_repository(ptr);
@@ -104,10 +155,17 @@ SEXP R_git_merge_cleanup(SEXP ptr){
   return R_NilValue;
 }
 
-/* Just assume 1 extra merge parent for now (besides HEAD), no octopus merge */
+/* Called once to count the merge heads, and once to fill the vector */
+typedef struct {
+  SEXP vec;
+  int n;
+} merge_heads_data;
+
 static int merge_heads_cb(const git_oid *oid, void *payload){
-  SEXP vec = payload;
-  SET_STRING_ELT(vec, 0, safe_char(git_oid_tostr_s(oid)));
+  merge_heads_data *data = payload;
+  if(data->vec != R_NilValue)
+    SET_STRING_ELT(data->vec, data->n, safe_char(git_oid_tostr_s(oid)));
+  data->n++;
   return 0;
 }
 
@@ -115,8 +173,99 @@ SEXP R_git_merge_parent_heads(SEXP ptr){
   git_repository *repo = get_git_repository(ptr);
   if(git_repository_state(repo) != GIT_REPOSITORY_STATE_MERGE)
     return R_NilValue;
-  SEXP parents = PROTECT(Rf_allocVector(STRSXP, 1));
-  git_repository_mergehead_foreach(repo, merge_heads_cb, parents);
+  merge_heads_data data = {R_NilValue, 0};
+  bail_if(git_repository_mergehead_foreach(repo, merge_heads_cb, &data), "git_repository_mergehead_foreach");
+  data.vec = PROTECT(Rf_allocVector(STRSXP, data.n));
+  data.n = 0;
+  bail_if(git_repository_mergehead_foreach(repo, merge_heads_cb, &data), "git_repository_mergehead_foreach");
   UNPROTECT(1);
-  return parents;
+  return data.vec;
+}
+
+/* Octopus merge: merges the heads one by one into an in-memory tree, each against the
+ * merge base of the head with HEAD and the heads that were merged before, like the
+ * octopus strategy of git. Heads with conflicts are reported and left out, such that
+ * the conflicts of every head are found in one pass. If all heads merged cleanly, the
+ * combined tree is checked out, and the caller commits it with all heads as parents. */
+SEXP R_git_merge_octopus(SEXP ptr, SEXP refs, SEXP checkout){
+  int len = Rf_length(refs);
+  int nmerged = 0;
+  int complete = 1;
+  git_commit *head = NULL;
+  git_tree *tree = NULL;
+  git_repository *repo = get_git_repository(ptr);
+  git_merge_options opts = GIT_MERGE_OPTIONS_INIT;
+  opts.flags |= GIT_MERGE_SKIP_REUC;
+  git_reference *ref = NULL;
+  bail_if(git_repository_head(&ref, repo), "git_repository_head");
+  bail_if(git_commit_lookup(&head, repo, git_reference_target(ref)), "git_commit_lookup");
+  git_reference_free(ref);
+  bail_if(git_commit_tree(&tree, head), "git_commit_tree");
+  git_oid *merged = (git_oid *) R_alloc(len + 2, sizeof(git_oid));
+  git_oid_cpy(&merged[1], git_commit_id(head));
+  git_commit_free(head);
+
+  SEXP ids = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP status = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP conflicts = PROTECT(Rf_allocVector(VECSXP, len));
+  for(int i = 0; i < len; i++){
+    git_oid base = {{0}};
+    git_tree *base_tree = NULL;
+    git_commit *base_commit = NULL;
+    git_tree *their_tree = NULL;
+    git_index *index = NULL;
+    git_commit *commit = lookup_commit(repo, STRING_ELT(refs, i));
+    SET_STRING_ELT(ids, i, safe_char(git_oid_tostr_s(git_commit_id(commit))));
+    SET_VECTOR_ELT(conflicts, i, Rf_allocVector(STRSXP, 0));
+    git_oid_cpy(&merged[0], git_commit_id(commit));
+    int res = git_merge_base_many(&base, repo, nmerged + 2, merged);
+    if(res == 0 && git_oid_equal(&base, git_commit_id(commit))){
+      SET_STRING_ELT(status, i, safe_char("up_to_date"));
+      git_commit_free(commit);
+      continue;
+    }
+    if(res == 0){
+      bail_if(git_commit_lookup(&base_commit, repo, &base), "git_commit_lookup");
+      bail_if(git_commit_tree(&base_tree, base_commit), "git_commit_tree");
+      git_commit_free(base_commit);
+    } else if(res == GIT_ENOTFOUND){
+      giterr_clear();
+    } else {
+      bail_if(res, "git_merge_base_many");
+    }
+    bail_if(git_commit_tree(&their_tree, commit), "git_commit_tree");
+    res = git_merge_trees(&index, repo, base_tree, tree, their_tree, &opts);
+    git_tree_free(base_tree);
+    git_tree_free(their_tree);
+    bail_if(res, "git_merge_trees");
+    if(git_index_has_conflicts(index)){
+      SET_STRING_ELT(status, i, safe_char("conflict"));
+      SET_VECTOR_ELT(conflicts, i, conflict_paths(index));
+      complete = 0;
+    } else {
+      git_oid tree_id = {{0}};
+      bail_if(git_index_write_tree_to(&tree_id, index, repo), "git_index_write_tree_to");
+      git_tree_free(tree);
+      bail_if(git_tree_lookup(&tree, repo, &tree_id), "git_tree_lookup");
+      git_oid_cpy(&merged[nmerged + 2], git_commit_id(commit));
+      nmerged++;
+      SET_STRING_ELT(status, i, safe_char("merged"));
+    }
+    git_index_free(index);
+    git_commit_free(commit);
+  }
+  if(complete && nmerged > 0 && Rf_asLogical(checkout)){
+    git_checkout_options checkout_opts = GIT_CHECKOUT_OPTIONS_INIT;
+    checkout_opts.checkout_strategy = GIT_CHECKOUT_SAFE;
+    set_checkout_notify_cb(&checkout_opts);
+    set_checkout_sparse(&checkout_opts, repo);
+    bail_if(git_checkout_tree(repo, (git_object *) tree, &checkout_opts), "git_checkout_tree");
+    sparse_checkout_sync(repo, (git_object *) tree);
+  }
+  SEXP tree_id = PROTECT(safe_string(complete ? git_oid_tostr_s(git_tree_id(tree)) : NULL));
+  git_tree_free(tree);
+  SEXP df = PROTECT(build_tibble(4, "ref", refs, "commit", ids, "status", status, "conflicts", conflicts));
+  SEXP out = build_list(2, "tree", tree_id, "heads", df);
+  UNPROTECT(5);
+  return out;
 }
@@ -0,0 +1,283 @@
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "utils.h"
+
+/* A small thread pool for running independent libgit2 operations concurrently,
+ * and background jobs that run a single operation while R stays responsive.
+ * Worker threads must never touch the R API. Anything that needs R, such as
+ * credential callbacks, is handed to the main thread with gert_run_on_main(), which
+ * blocks the worker until the main thread has serviced the request. Cancellation is
+ * scoped: an interrupt of a pool run only cancels the tasks of that run, and a job is
+ * only cancelled through its own cancel flag. */
+
+typedef struct main_request {
+  int (*fn)(void *arg);
+  void *arg;
+  volatile int *cancel;
+  int pooled;
+  int result;
+  int done;
+  struct main_request *next;
+} main_request;
+
+struct gert_job {
+  pthread_t thread;
+  void (*fn)(void *data);
+  void (*free_fn)(void *data);
+  void *data;
+  int done;
+  int orphaned;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t answered = PTHREAD_COND_INITIALIZER;
+static pthread_t main_thread;
+static main_request *queue = NULL;
+static int running = 0;
+static volatile int cancelled = 0;
+static pthread_key_t pool_thread;
+
+static struct {
+  int ntasks;
+  int next;
+  int finished;
+  gert_task_fn fn;
+  void *data;
+} pool;
+
+double gert_time_now(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static void check_interrupt_fn(void *dummy){
+  R_CheckUserInterrupt();
+}
+
+/* Check for interrupts without longjmp-ing out, for callers that hold threads or
+ * other resources that must be released before raising the error */
+int gert_pending_interrupt(void){
+  return !(R_ToplevelExec(check_interrupt_fn, NULL));
+}
+
+void gert_parallel_init(void){
+  main_thread = pthread_self();
+  pthread_key_create(&pool_thread, NULL);
+}
+
+static int is_main_thread(void){
+  return pthread_equal(pthread_self(), main_thread);
+}
+
+/* Whether the caller is a task of the current gert_parallel_run(), which runs either on
+ * a worker of the pool or, without threads, on the main thread */
+static int in_pool_run(void){
+  return running && (is_main_thread() || pthread_getspecific(pool_thread) != NULL);
+}
+
+/* Only meaningful for tasks of gert_parallel_run(), background jobs are never cancelled
+ * by an interrupt of a pool run */
+int gert_parallel_cancelled(void){
+  if(!in_pool_run())
+    return 0;
+  if(!cancelled && is_main_thread() && gert_pending_interrupt())
+    cancelled = 1;
+  return cancelled;
+}
+
+static void run_request(void *arg){
+  main_request *req = arg;
+  req->result = req->fn(req->arg);
+}
+
+static int request_cancelled(main_request *req){
+  return (req->pooled && cancelled) || (req->cancel && *req->cancel);
+}
+
+/* Services requests from workers; must be called by the main thread with the lock held.
+ * Cancelled requests are answered with an error without calling into R. */
+static void service_queue(int run){
+  main_request **prev = &queue;
+  while(*prev){
+    main_request *req = *prev;
+    if(!run && !request_cancelled(req)){
+      prev = &req->next;
+      continue;
+    }
+    *prev = req->next;
+    pthread_mutex_unlock(&lock);
+    if(!request_cancelled(req))
+      R_ToplevelExec(run_request, req);
+    pthread_mutex_lock(&lock);
+    req->done = 1;
+    pthread_cond_broadcast(&answered);
+    prev = &queue;
+  }
+}
+
+void gert_service_main_queue(void){
+  pthread_mutex_lock(&lock);
+  service_queue(1);
+  pthread_mutex_unlock(&lock);
+}
+
+/* A cancelled caller gets an error right away. Requests that were queued before their
+ * caller was cancelled are answered by gert_job_release() or the next service_queue(). */
+int gert_run_on_main(int (*fn)(void *arg), void *arg, volatile int *cancel){
+  main_request req = {fn, arg, cancel, in_pool_run(), -1, 0, NULL};
+  if(is_main_thread()){
+    if(!running)
+      return fn(arg);
+    if(!request_cancelled(&req))
+      R_ToplevelExec(run_request, &req);
+    return req.result;
+  }
+  pthread_mutex_lock(&lock);
+  if(request_cancelled(&req)){
+    pthread_mutex_unlock(&lock);
+    return req.result;
+  }
+  main_request **tail = &queue;
+  while(*tail)
+    tail = &(*tail)->next;
+  *tail = &req;
+  pthread_cond_signal(&wakeup);
+  while(!req.done)
+    pthread_cond_wait(&answered, &lock);
+  pthread_mutex_unlock(&lock);
+  return req.result;
+}
+
+static void *worker(void *unused){
+  pthread_setspecific(pool_thread, &pool);
+  while(1){
+    pthread_mutex_lock(&lock);
+    int i = pool.next < pool.ntasks ? pool.next++ : -1;
+    pthread_mutex_unlock(&lock);
+    if(i < 0)
+      break;
+    pool.fn(pool.data, i);
+    pthread_mutex_lock(&lock);
+    pool.finished++;
+    pthread_cond_signal(&wakeup);
+    pthread_mutex_unlock(&lock);
+  }
+  return NULL;
+}
+
+/* Runs fn(data, i) for i in 0..ntasks-1 on at most nthreads threads. Returns non-zero
+ * if the user interrupted, in which case tasks should have been aborted early by
+ * checking gert_parallel_cancelled(). Falls back to running the tasks on the main
+ * thread if libgit2 was built without thread support. */
+int gert_parallel_run(int ntasks, int nthreads, gert_task_fn fn, void *data){
+  if(running)
+    Rf_error("A parallel git operation is already running");
+  if(!(git_libgit2_features() & GIT_FEATURE_THREADS))
+    nthreads = 1;
+  if(nthreads > ntasks)
+    nthreads = ntasks;
+  cancelled = 0;
+  running = 1;
+  if(nthreads <= 1){
+    for(int i = 0; i < ntasks && !gert_parallel_cancelled(); i++)
+      fn(data, i);
+    running = 0;
+    return cancelled;
+  }
+  pool.ntasks = ntasks;
+  pool.next = 0;
+  pool.finished = 0;
+  pool.fn = fn;
+  pool.data = data;
+  int started = 0;
+  pthread_t *threads = (pthread_t *) R_alloc(nthreads, sizeof(pthread_t));
+  for(int i = 0; i < nthreads; i++){
+    if(pthread_create(&threads[started], NULL, worker, NULL) == 0)
+      started++;
+  }
+  if(started == 0){
+    running = 0;
+    Rf_error("Failed to start worker threads");
+  }
+  pthread_mutex_lock(&lock);
+  while(pool.finished < pool.ntasks){
+    service_queue(1);
+    if(pool.finished == pool.ntasks)
+      break;
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += 100 * 1000000;
+    if(deadline.tv_nsec >= 1000000000){
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+    if(!queue && pthread_cond_timedwait(&wakeup, &lock, &deadline) != 0 && !cancelled){
+      pthread_mutex_unlock(&lock);
+      if(gert_pending_interrupt())
+        cancelled = 1;
+      pthread_mutex_lock(&lock);
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  for(int i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
+  running = 0;
+  return cancelled;
+}
+
+static void *job_main(void *arg){
+  gert_job *job = arg;
+  job->fn(job->data);
+  pthread_mutex_lock(&lock);
+  job->done = 1;
+  int orphaned = job->orphaned;
+  pthread_mutex_unlock(&lock);
+  if(orphaned){
+    job->free_fn(job->data);
+    free(job);
+  }
+  return NULL;
+}
+
+/* Starts fn(data) on a background thread. Requests from the job to the main thread
+ * are serviced whenever R calls gert_service_main_queue(). */
+gert_job *gert_job_start(void (*fn)(void *data), void *data, void (*free_fn)(void *data)){
+  gert_job *job = calloc(1, sizeof(gert_job));
+  job->fn = fn;
+  job->data = data;
+  job->free_fn = free_fn;
+  if(pthread_create(&job->thread, NULL, job_main, job)){
+    free(job);
+    return NULL;
+  }
+  return job;
+}
+
+int gert_job_done(gert_job *job){
+  pthread_mutex_lock(&lock);
+  int done = job->done;
+  pthread_mutex_unlock(&lock);
+  return done;
+}
+
+/* Frees a finished job, or lets an unfinished job clean up after itself when it is
+ * done. The caller should have cancelled the job, so that its pending requests to
+ * the main thread are answered here without calling into R. */
+void gert_job_release(gert_job *job){
+  pthread_mutex_lock(&lock);
+  if(job->done){
+    pthread_mutex_unlock(&lock);
+    pthread_join(job->thread, NULL);
+    job->free_fn(job->data);
+    free(job);
+    return;
+  }
+  pthread_t thread = job->thread;
+  job->orphaned = 1;
+  service_queue(0);
+  pthread_mutex_unlock(&lock);
+  pthread_detach(thread);
+}
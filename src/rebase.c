@@ -70,6 +70,124 @@ SEXP R_git_rebase(SEXP ptr, SEXP upstream, SEXP commit_changes){
   return out;
 }
 
+/* Refuses to move the branch that is checked out, because its working tree would no
+ * longer match. Returns the (resolved) reference to update. */
+static git_reference *rebase_target_ref(git_repository *repo, const char *name){
+  git_reference *ref = NULL;
+  git_reference *resolved = NULL;
+  git_reference *head = NULL;
+  bail_if(git_reference_dwim(&ref, repo, name), "git_reference_dwim");
+  bail_if(git_reference_resolve(&resolved, ref), "git_reference_resolve");
+  git_reference_free(ref);
+  if(!git_repository_is_bare(repo) && git_repository_head(&head, repo) == 0){
+    int checked_out = !strcmp(git_reference_name(head), git_reference_name(resolved));
+    git_reference_free(head);
+    if(checked_out){
+      git_reference_free(resolved);
+      Rf_error("Cannot move '%s' because it is checked out", name);
+    }
+  }
+  giterr_clear();
+  return resolved;
+}
+
+/* Updates the target to the new tip, if it still points to the original commit. The
+ * reference is freed. Returns if the reference was moved. */
+static int move_target_ref(git_repository *repo, git_reference *target, const git_oid *tip,
+                           const git_oid *orig_id, int complete, const char *message){
+  git_reference *out = NULL;
+  int err = complete ? git_reference_create_matching(&out, repo, git_reference_name(target), tip, 1,
+                                                     orig_id, message) : 0;
+  git_reference_free(target);
+  bail_if(err, "git_reference_create_matching");
+  git_reference_free(out);
+  return complete;
+}
+
+/* Rebases a branch entirely in memory: every step that applies cleanly is committed to
+ * the object database, and the rebase stops at the first step with conflicts. HEAD,
+ * the index and the working tree are never touched. The branch is only moved if all
+ * steps applied, and only if it still points to the commit that was rebased. */
+SEXP R_git_rebase_inmemory(SEXP ptr, SEXP branch, SEXP upstream, SEXP onto, SEXP move_ref){
+  git_rebase *rebase = NULL;
+  git_rebase_operation *operation = NULL;
+  git_annotated_commit *branch_head = NULL;
+  git_annotated_commit *upstream_head = NULL;
+  git_annotated_commit *onto_head = NULL;
+  git_reference *target = NULL;
+  git_repository *repo = get_git_repository(ptr);
+  git_rebase_options opt = GIT_REBASE_OPTIONS_INIT;
+  opt.inmemory = 1;
+  if(Rf_asLogical(move_ref))
+    target = rebase_target_ref(repo, CHAR(STRING_ELT(branch, 0)));
+  bail_if(git_annotated_commit_from_revspec(&branch_head, repo, CHAR(STRING_ELT(branch, 0))),
+          "git_annotated_commit_from_revspec");
+  bail_if(git_annotated_commit_from_revspec(&upstream_head, repo, CHAR(STRING_ELT(upstream, 0))),
+          "git_annotated_commit_from_revspec");
+  if(Rf_length(onto))
+    bail_if(git_annotated_commit_from_revspec(&onto_head, repo, CHAR(STRING_ELT(onto, 0))),
+            "git_annotated_commit_from_revspec");
+  bail_if(git_rebase_init(&rebase, repo, branch_head, upstream_head, onto_head, &opt), "git_rebase_init");
+  git_oid orig_id = *git_annotated_commit_id(branch_head);
+  git_oid tip = *git_annotated_commit_id(onto_head ? onto_head : upstream_head);
+  git_annotated_commit_free(branch_head);
+  git_annotated_commit_free(upstream_head);
+  git_annotated_commit_free(onto_head);
+
+  size_t len = git_rebase_operation_entrycount(rebase);
+  SEXP commits = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP new_commits = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP status = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP conflicts = PROTECT(Rf_allocVector(VECSXP, len));
+  int complete = 1;
+  int moved = 0;
+  for(size_t i = 0; i < len; i++){
+    SET_STRING_ELT(new_commits, i, NA_STRING);
+    SET_VECTOR_ELT(conflicts, i, Rf_allocVector(STRSXP, 0));
+    if(!complete){
+      SET_STRING_ELT(commits, i, safe_char(git_oid_tostr_s(&git_rebase_operation_byindex(rebase, i)->id)));
+      SET_STRING_ELT(status, i, safe_char("pending"));
+      continue;
+    }
+    bail_if(git_rebase_next(&operation, rebase), "git_rebase_next");
+    SET_STRING_ELT(commits, i, safe_char(git_oid_tostr_s(&operation->id)));
+    git_index *index = NULL;
+    bail_if(git_rebase_inmemory_index(&index, rebase), "git_rebase_inmemory_index");
+    if(git_index_has_conflicts(index)){
+      SET_VECTOR_ELT(conflicts, i, conflict_paths(index));
+      SET_STRING_ELT(status, i, safe_char("conflict"));
+      git_index_free(index);
+      complete = 0;
+      continue;
+    }
+    git_index_free(index);
+    git_commit *orig = NULL;
+    git_oid new_oid = {{0}};
+    bail_if(git_commit_lookup(&orig, repo, &operation->id), "git_commit_lookup");
+    int err = git_rebase_commit(&new_oid, rebase, NULL, git_commit_committer(orig), NULL, NULL);
+    git_commit_free(orig);
+    if(err == GIT_EAPPLIED){
+      giterr_clear();
+      SET_STRING_ELT(status, i, safe_char("skipped"));
+    } else {
+      bail_if(err, "git_rebase_commit");
+      tip = new_oid;
+      SET_STRING_ELT(new_commits, i, safe_char(git_oid_tostr_s(&new_oid)));
+      SET_STRING_ELT(status, i, safe_char("applied"));
+    }
+  }
+  git_rebase_free(rebase);
+  if(target)
+    moved = move_target_ref(repo, target, &tip, &orig_id, complete, "rebase: in-memory");
+  SEXP head = PROTECT(safe_string(git_oid_tostr_s(&tip)));
+  SEXP df = PROTECT(build_tibble(4, "commit", commits, "new_commit", new_commits,
+                                 "status", status, "conflicts", conflicts));
+  SEXP out = build_list(4, "steps", df, "head", head, "complete", PROTECT(Rf_ScalarLogical(complete)),
+                        "moved", PROTECT(Rf_ScalarLogical(moved)));
+  UNPROTECT(8);
+  return out;
+}
+
 static int count_changes(git_repository *repo){
   git_status_options opts = GIT_STATUS_OPTIONS_INIT;
   opts.show = GIT_STATUS_SHOW_INDEX_ONLY;
@@ -118,6 +236,82 @@ SEXP R_git_cherry_pick(SEXP ptr, SEXP commit_id){
   return safe_string(git_oid_tostr_s(&new_oid));
 }
 
+/* Cherry-picks a range of commits onto a base, one after the other, with an in-memory
+ * index: only objects are written, and the working tree is never touched. A commit
+ * that results in the same tree as its new parent is skipped, which replaces the
+ * status scan of R_git_cherry_pick. Stops at the first commit with conflicts. */
+SEXP R_git_cherry_pick_range(SEXP ptr, SEXP commits, SEXP onto, SEXP move_ref){
+  git_reference *target = NULL;
+  git_repository *repo = get_git_repository(ptr);
+  git_merge_options merge_opts = GIT_MERGE_OPTIONS_INIT;
+  merge_opts.flags |= GIT_MERGE_SKIP_REUC;
+  if(Rf_asLogical(move_ref))
+    target = rebase_target_ref(repo, CHAR(STRING_ELT(onto, 0)));
+  git_object *base = resolve_refish(onto, repo);
+  git_oid orig_id = *git_object_id(base);
+  git_commit *parent = (git_commit *) base;
+  int len = Rf_length(commits);
+  SEXP new_commits = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP status = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP conflicts = PROTECT(Rf_allocVector(VECSXP, len));
+  int complete = 1;
+  for(int i = 0; i < len; i++){
+    SET_STRING_ELT(new_commits, i, NA_STRING);
+    SET_VECTOR_ELT(conflicts, i, Rf_allocVector(STRSXP, 0));
+    if(!complete){
+      SET_STRING_ELT(status, i, safe_char("pending"));
+      continue;
+    }
+    git_index *index = NULL;
+    git_commit *orig = NULL;
+    git_object *revision = resolve_refish(PROTECT(Rf_ScalarString(STRING_ELT(commits, i))), repo);
+    UNPROTECT(1);
+    orig = (git_commit *) revision;
+
+    /* Merge commits are picked relative to their first parent */
+    unsigned int mainline = git_commit_parentcount(orig) > 1 ? 1 : 0;
+    bail_if(git_cherrypick_commit(&index, repo, orig, parent, mainline, &merge_opts), "git_cherrypick_commit");
+    if(git_index_has_conflicts(index)){
+      SET_VECTOR_ELT(conflicts, i, conflict_paths(index));
+      SET_STRING_ELT(status, i, safe_char("conflict"));
+      complete = 0;
+    } else {
+      git_oid tree_id = {{0}};
+      bail_if(git_index_write_tree_to(&tree_id, index, repo), "git_index_write_tree_to");
+      if(git_oid_equal(&tree_id, git_commit_tree_id(parent))){
+        SET_STRING_ELT(status, i, safe_char("empty"));
+      } else {
+        git_oid new_oid = {{0}};
+        git_tree *tree = NULL;
+        git_commit *new_commit = NULL;
+        const git_commit *parents[1] = {parent};
+        bail_if(git_tree_lookup(&tree, repo, &tree_id), "git_tree_lookup");
+        bail_if(git_commit_create(&new_oid, repo, NULL, git_commit_author(orig),
+                                  git_commit_committer(orig), git_commit_message_encoding(orig),
+                                  git_commit_message(orig), tree, 1, no_const_workaround parents), "git_commit_create");
+        git_tree_free(tree);
+        bail_if(git_commit_lookup(&new_commit, repo, &new_oid), "git_commit_lookup");
+        git_commit_free(parent);
+        parent = new_commit;
+        SET_STRING_ELT(new_commits, i, safe_char(git_oid_tostr_s(&new_oid)));
+        SET_STRING_ELT(status, i, safe_char("applied"));
+      }
+    }
+    git_index_free(index);
+    git_commit_free(orig);
+  }
+  git_oid tip = *git_commit_id(parent);
+  git_commit_free(parent);
+  int moved = target ? move_target_ref(repo, target, &tip, &orig_id, complete, "cherry-pick: in-memory") : 0;
+  SEXP head = PROTECT(safe_string(git_oid_tostr_s(&tip)));
+  SEXP df = PROTECT(build_tibble(4, "commit", commits, "new_commit", new_commits,
+                                 "status", status, "conflicts", conflicts));
+  SEXP out = build_list(4, "steps", df, "head", head, "complete", PROTECT(Rf_ScalarLogical(complete)),
+                        "moved", PROTECT(Rf_ScalarLogical(moved)));
+  UNPROTECT(7);
+  return out;
+}
+
 SEXP R_git_ahead_behind(SEXP ptr, SEXP local, SEXP upstream){
   size_t ahead, behind;
   git_repository *repo = get_git_repository(ptr);
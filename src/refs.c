@@ -0,0 +1,138 @@
+#include <string.h>
+#include "utils.h"
+
+/* Collect all refs in a single pass over the refdb, growing the buffer as needed */
+git_reference **collect_references(git_repository *repo, const char *glob, size_t *len){
+  int res = 0;
+  size_t n = 0;
+  size_t size = 64;
+  git_reference *ref = NULL;
+  git_reference_iterator *iter = NULL;
+  if(glob){
+    bail_if(git_reference_iterator_glob_new(&iter, repo, glob), "git_reference_iterator_glob_new");
+  } else {
+    bail_if(git_reference_iterator_new(&iter, repo), "git_reference_iterator_new");
+  }
+  /* Allocated after the iterator, such that a failure above can not leak it */
+  git_reference **refs = malloc(size * sizeof *refs);
+  while(refs && (res = git_reference_next(&ref, iter)) != GIT_ITEROVER){
+    if(res){
+      git_reference_iterator_free(iter);
+      for(size_t i = 0; i < n; i++)
+        git_reference_free(refs[i]);
+      free(refs);
+      bail_if(res, "git_reference_next");
+    }
+    if(n == size){
+      git_reference **bigger = realloc(refs, 2 * size * sizeof *refs);
+      if(bigger == NULL){
+        git_reference_free(ref);
+        for(size_t i = 0; i < n; i++)
+          git_reference_free(refs[i]);
+        free(refs);
+      }
+      refs = bigger;
+      size *= 2;
+    }
+    if(refs)
+      refs[n++] = ref;
+  }
+  if(refs == NULL){
+    git_reference_iterator_free(iter);
+    Rf_error("Failed to allocate memory for references");
+  }
+  git_reference_iterator_free(iter);
+  *len = n;
+  return refs;
+}
+
+SEXP R_git_reference_list(SEXP ptr, SEXP glob){
+  size_t len = 0;
+  git_repository *repo = get_git_repository(ptr);
+  const char *cglob = Rf_length(glob) ? CHAR(STRING_ELT(glob, 0)) : NULL;
+  git_reference **refs = collect_references(repo, cglob, &len);
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP shorthands = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP types = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP targets = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP symrefs = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP commits = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP times = PROTECT(Rf_allocVector(REALSXP, len));
+  for(size_t i = 0; i < len; i++){
+    git_reference *ref = refs[i];
+    int is_symbolic = git_reference_type(ref) == GIT_REFERENCE_SYMBOLIC;
+    SET_STRING_ELT(names, i, safe_char(git_reference_name(ref)));
+    SET_STRING_ELT(shorthands, i, safe_char(git_reference_shorthand(ref)));
+    SET_STRING_ELT(types, i, safe_char(is_symbolic ? "symbolic" : "direct"));
+    SET_STRING_ELT(targets, i, is_symbolic ? NA_STRING : safe_char(git_oid_tostr_s(git_reference_target(ref))));
+    SET_STRING_ELT(symrefs, i, safe_char(is_symbolic ? git_reference_symbolic_target(ref) : NULL));
+    SET_STRING_ELT(commits, i, NA_STRING);
+    REAL(times)[i] = NA_REAL;
+
+    /* Peeled commits come from the object cache, so refs sharing a target parse it once */
+    git_object *obj = NULL;
+    if(git_reference_peel(&obj, ref, GIT_OBJECT_COMMIT) == GIT_OK){
+      SET_STRING_ELT(commits, i, safe_char(git_oid_tostr_s(git_object_id(obj))));
+      REAL(times)[i] = git_commit_time((git_commit *) obj);
+      git_object_free(obj);
+    }
+    git_reference_free(ref);
+  }
+  free(refs);
+  Rf_setAttrib(times, R_ClassSymbol, make_strvec(2, "POSIXct", "POSIXt"));
+  SEXP out = build_tibble(7, "name", names, "shorthand", shorthands, "type", types, "target", targets,
+                          "symref", symrefs, "commit", commits, "time", times);
+  UNPROTECT(7);
+  return out;
+}
+
+SEXP R_git_reflog_list(SEXP ptr, SEXP ref, SEXP max, SEXP after){
+  git_reflog *reflog = NULL;
+  git_reference *reference = NULL;
+  git_repository *repo = get_git_repository(ptr);
+  const char *name = CHAR(STRING_ELT(ref, 0));
+
+  /* Expand shorthands such as 'main' or 'origin/main' to the full ref name */
+  if(strcmp(name, "HEAD") && git_reference_dwim(&reference, repo, name) == GIT_OK)
+    name = git_reference_name(reference);
+  int err = git_reflog_read(&reflog, repo, name);
+  git_reference_free(reference);
+  bail_if(err, "git_reflog_read");
+
+  /* Entries are newest first, so we can stop at the first one that is too old */
+  size_t total = git_reflog_entrycount(reflog);
+  size_t len = Rf_length(max) && Rf_asInteger(max) >= 0 ? Rf_asInteger(max) : total;
+  if(len > total)
+    len = total;
+  if(Rf_length(after)){
+    double time_min = Rf_asReal(after);
+    for(size_t i = 0; i < len; i++){
+      if(git_reflog_entry_committer(git_reflog_entry_byindex(reflog, i))->when.time < time_min){
+        len = i;
+        break;
+      }
+    }
+  }
+  SEXP indexes = PROTECT(Rf_allocVector(INTSXP, len));
+  SEXP olds = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP news = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP committer = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP times = PROTECT(Rf_allocVector(REALSXP, len));
+  SEXP msg = PROTECT(Rf_allocVector(STRSXP, len));
+  for(size_t i = 0; i < len; i++){
+    const git_reflog_entry *entry = git_reflog_entry_byindex(reflog, i);
+    const git_signature *sig = git_reflog_entry_committer(entry);
+    INTEGER(indexes)[i] = i;
+    SET_STRING_ELT(olds, i, safe_char(git_oid_tostr_s(git_reflog_entry_id_old(entry))));
+    SET_STRING_ELT(news, i, safe_char(git_oid_tostr_s(git_reflog_entry_id_new(entry))));
+    SET_STRING_ELT(committer, i, make_author(sig));
+    REAL(times)[i] = sig->when.time;
+    SET_STRING_ELT(msg, i, safe_char(git_reflog_entry_message(entry)));
+  }
+  git_reflog_free(reflog);
+  Rf_setAttrib(times, R_ClassSymbol, make_strvec(2, "POSIXct", "POSIXt"));
+  SEXP out = build_tibble(6, "index", indexes, "old", olds, "new", news, "committer", committer,
+                          "time", times, "message", msg);
+  UNPROTECT(6);
+  return out;
+}
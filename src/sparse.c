@@ -0,0 +1,261 @@
+#include <string.h>
+#include <unistd.h>
+#include "utils.h"
+
+/* Sparse checkout: the working tree only contains files matching a set of pathspecs.
+ * Git reads info/sparse-checkout with gitignore or cone semantics, which would select
+ * different files than our pathspecs, so the patterns are kept in a file of our own,
+ * info/gert-sparse-checkout, enabled with the gert.sparseCheckout config. libgit2 has no
+ * native support, so the patterns are passed as checkout paths, and the index entries
+ * of skipped files are kept equal to the checked out tree, such that they do not show
+ * up as staged changes. Like git, these entries have the skip-worktree flag, so the git
+ * CLI does not report them as deleted either. */
+
+static char *sparse_file(git_repository *repo){
+  const char *gitdir = git_repository_path(repo);
+  size_t len = strlen(gitdir) + 30;
+  char *path = R_alloc(len, 1);
+  snprintf(path, len, "%sinfo/gert-sparse-checkout", gitdir);
+  return path;
+}
+
+static int sparse_checkout_enabled(git_repository *repo){
+  int enabled = 0;
+  git_config *cfg = NULL;
+  if(git_repository_is_bare(repo) || git_repository_config_snapshot(&cfg, repo))
+    return 0;
+  if(git_config_get_bool(&enabled, cfg, "gert.sparseCheckout"))
+    enabled = 0;
+  git_config_free(cfg);
+  return enabled;
+}
+
+/* Reads the patterns into memory that is freed by R. Returns 0 if sparse checkout is disabled. */
+int sparse_checkout_paths(git_repository *repo, git_strarray *out){
+  if(!sparse_checkout_enabled(repo))
+    return 0;
+  FILE *fp = fopen(sparse_file(repo), "r");
+  if(fp == NULL)
+    return 0;
+  char line[4096];
+  size_t size = 16;
+  out->count = 0;
+  out->strings = (char **) R_alloc(size, sizeof(char *));
+  while(fgets(line, sizeof(line), fp)){
+    line[strcspn(line, "\r\n")] = '\0';
+    if(line[0] == '\0' || line[0] == '#')
+      continue;
+    if(out->count == size){
+      char **strings = (char **) R_alloc(2 * size, sizeof(char *));
+      memcpy(strings, out->strings, size * sizeof(char *));
+      out->strings = strings;
+      size *= 2;
+    }
+    out->strings[out->count] = R_alloc(strlen(line) + 1, 1);
+    strcpy(out->strings[out->count++], line);
+  }
+  fclose(fp);
+  return out->count > 0;
+}
+
+/* Limits a checkout to the sparse patterns, unless specific paths were given */
+void set_checkout_sparse(git_checkout_options *opts, git_repository *repo){
+  if(opts->paths.count == 0)
+    sparse_checkout_paths(repo, &opts->paths);
+}
+
+typedef struct {
+  git_index *index;
+  git_pathspec *ps;
+} sparse_walk_data;
+
+static int add_skipped_entry(const char *root, const git_tree_entry *entry, void *payload){
+  sparse_walk_data *data = payload;
+  if(git_tree_entry_type(entry) != GIT_OBJECT_BLOB)
+    return 0;
+  char path[4000];
+  snprintf(path, sizeof(path), "%s%s", root, git_tree_entry_name(entry));
+  if(git_pathspec_matches_path(data->ps, 0, path))
+    return 0;
+  /* Staged changes and conflicts that were kept by sync_index() */
+  for(int stage = 0; stage <= 3; stage++){
+    if(git_index_get_bypath(data->index, path, stage))
+      return 0;
+  }
+  git_index_entry ie;
+  memset(&ie, 0, sizeof(ie));
+  ie.mode = git_tree_entry_filemode(entry);
+  ie.path = path;
+  ie.flags_extended = GIT_INDEX_ENTRY_SKIP_WORKTREE;
+  git_oid_cpy(&ie.id, git_tree_entry_id(entry));
+  return git_index_add(data->index, &ie);
+}
+
+static int same_as_tree(git_tree *tree, const git_index_entry *entry){
+  git_tree_entry *te = NULL;
+  if(git_tree_entry_bypath(&te, tree, entry->path)){
+    giterr_clear();
+    return 0;
+  }
+  int same = git_oid_equal(git_tree_entry_id(te), &entry->id) && git_tree_entry_filemode(te) == entry->mode;
+  git_tree_entry_free(te);
+  return same;
+}
+
+static void sync_index(git_repository *repo, git_object *treeish, git_strarray *paths){
+  git_tree *tree = NULL;
+  git_index *index = NULL;
+  git_pathspec *ps = NULL;
+  bail_if(git_object_peel((git_object **) &tree, treeish, GIT_OBJECT_TREE), "git_object_peel");
+  bail_if(git_repository_index(&index, repo), "git_repository_index");
+  bail_if(git_pathspec_new(&ps, paths), "git_pathspec_new");
+  int err = 0;
+  for(size_t i = git_index_entrycount(index); i > 0 && !err; i--){
+    const git_index_entry *entry = git_index_get_byindex(index, i - 1);
+    if(!git_pathspec_matches_path(ps, 0, entry->path)){
+      /* Entries that we skipped before, or that equal the tree, are added again from the
+       * tree below. Conflicts and staged changes outside the patterns are kept as is. */
+      if(git_index_entry_stage(entry) == 0 && ((entry->flags_extended & GIT_INDEX_ENTRY_SKIP_WORKTREE) ||
+                                               same_as_tree(tree, entry)))
+        git_index_remove(index, entry->path, 0);
+    } else if(entry->flags_extended & GIT_INDEX_ENTRY_SKIP_WORKTREE){
+      /* checked out again, e.g. after the patterns were extended */
+      git_index_entry copy = *entry;
+      copy.flags_extended &= ~GIT_INDEX_ENTRY_SKIP_WORKTREE;
+      err = git_index_add(index, &copy);
+    }
+  }
+  sparse_walk_data data = {index, ps};
+  if(!err)
+    err = git_tree_walk(tree, GIT_TREEWALK_PRE, add_skipped_entry, &data);
+  if(!err)
+    err = git_index_write(index);
+  git_pathspec_free(ps);
+  git_index_free(index);
+  git_tree_free(tree);
+  bail_if(err, "git_index_write");
+}
+
+/* To be called after a checkout of treeish, see above */
+void sparse_checkout_sync(git_repository *repo, git_object *treeish){
+  git_strarray paths = {0};
+  if(sparse_checkout_paths(repo, &paths))
+    sync_index(repo, treeish, &paths);
+}
+
+/* Removes unmodified files that are no longer matched by the patterns */
+static void remove_skipped_files(git_repository *repo, git_strarray *paths){
+  git_index *index = NULL;
+  git_pathspec *ps = NULL;
+  const char *workdir = git_repository_workdir(repo);
+  bail_if(git_repository_index(&index, repo), "git_repository_index");
+  bail_if(git_pathspec_new(&ps, paths), "git_pathspec_new");
+  for(size_t i = 0; i < git_index_entrycount(index); i++){
+    const git_index_entry *entry = git_index_get_byindex(index, i);
+    unsigned int flags = 0;
+    if(git_pathspec_matches_path(ps, 0, entry->path) || git_index_entry_stage(entry) > 0)
+      continue;
+    char path[4000];
+    size_t len = strlen(workdir);
+    snprintf(path, sizeof(path), "%s%s", workdir, entry->path);
+    if(git_status_file(&flags, repo, path + len) || flags != GIT_STATUS_CURRENT)
+      continue;
+    if(remove(path) == 0){
+      /* Clean up directories that became empty */
+      char *sep;
+      while((sep = strrchr(path, '/')) && sep > path + len){
+        *sep = '\0';
+        if(rmdir(path))
+          break;
+      }
+    }
+  }
+  git_pathspec_free(ps);
+  git_index_free(index);
+}
+
+void sparse_checkout_save(git_repository *repo, SEXP patterns){
+  git_config *cfg = NULL;
+  FILE *fp = fopen(sparse_file(repo), "w");
+  if(fp == NULL)
+    Rf_error("Failed to write %s", sparse_file(repo));
+  for(int i = 0; i < Rf_length(patterns); i++)
+    fprintf(fp, "%s\n", CHAR(STRING_ELT(patterns, i)));
+  fclose(fp);
+  bail_if(git_repository_config(&cfg, repo), "git_repository_config");
+  int err = git_config_set_bool(cfg, "gert.sparseCheckout", 1);
+  git_config_free(cfg);
+  bail_if(err, "git_config_set_bool");
+}
+
+static void checkout_head(git_repository *repo){
+  git_object *head = NULL;
+  git_checkout_options opts = GIT_CHECKOUT_OPTIONS_INIT;
+  opts.checkout_strategy = GIT_CHECKOUT_SAFE | GIT_CHECKOUT_RECREATE_MISSING;
+  set_checkout_notify_cb(&opts);
+  set_checkout_sparse(&opts, repo);
+  bail_if(git_revparse_single(&head, repo, "HEAD"), "git_revparse_single");
+  int err = git_checkout_tree(repo, head, &opts);
+  if(!err)
+    sparse_checkout_sync(repo, head);
+  git_object_free(head);
+  bail_if(err, "git_checkout_tree");
+}
+
+SEXP R_git_sparse_checkout_set(SEXP ptr, SEXP patterns){
+  git_strarray paths = {0};
+  git_repository *repo = get_git_repository(ptr);
+  if(git_repository_is_bare(repo))
+    Rf_error("Sparse checkout requires a working directory");
+  sparse_checkout_save(repo, patterns);
+  if(sparse_checkout_paths(repo, &paths))
+    remove_skipped_files(repo, &paths);
+  if(!git_repository_head_unborn(repo))
+    checkout_head(repo);
+  return ptr;
+}
+
+SEXP R_git_sparse_checkout_list(SEXP ptr){
+  git_strarray paths = {0};
+  git_repository *repo = get_git_repository(ptr);
+  if(!sparse_checkout_paths(repo, &paths))
+    return R_NilValue;
+  SEXP out = PROTECT(Rf_allocVector(STRSXP, paths.count));
+  for(size_t i = 0; i < paths.count; i++)
+    SET_STRING_ELT(out, i, safe_char(paths.strings[i]));
+  UNPROTECT(1);
+  return out;
+}
+
+/* All files are checked out again, so no entry should be skipped anymore */
+static void clear_skip_worktree(git_repository *repo){
+  int err = 0;
+  git_index *index = NULL;
+  bail_if(git_repository_index(&index, repo), "git_repository_index");
+  for(size_t i = 0; i < git_index_entrycount(index) && !err; i++){
+    const git_index_entry *entry = git_index_get_byindex(index, i);
+    if(entry->flags_extended & GIT_INDEX_ENTRY_SKIP_WORKTREE){
+      git_index_entry copy = *entry;
+      copy.flags_extended &= ~GIT_INDEX_ENTRY_SKIP_WORKTREE;
+      err = git_index_add(index, &copy);
+    }
+  }
+  if(!err)
+    err = git_index_write(index);
+  git_index_free(index);
+  bail_if(err, "git_index_write");
+}
+
+SEXP R_git_sparse_checkout_disable(SEXP ptr){
+  git_config *cfg = NULL;
+  git_repository *repo = get_git_repository(ptr);
+  bail_if(git_repository_config(&cfg, repo), "git_repository_config");
+  int err = git_config_set_bool(cfg, "gert.sparseCheckout", 0);
+  git_config_free(cfg);
+  bail_if(err, "git_config_set_bool");
+  remove(sparse_file(repo));
+  clear_skip_worktree(repo);
+  if(!git_repository_head_unborn(repo))
+    checkout_head(repo);
+  return ptr;
+}
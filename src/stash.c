@@ -16,11 +16,36 @@ SEXP R_git_stash_save(SEXP ptr, SEXP message, SEXP keep_index,
   return safe_string(git_oid_tostr_s(&out));
 }
 
-SEXP R_git_stash_pop(SEXP ptr, SEXP index){
+static int stash_progress_cb(git_stash_apply_progress_t progress, void *payload){
+  static const char *steps[] = {"", "loading stash", "restoring index", "restoring modified files",
+                                "restoring untracked files", "checking out untracked files",
+                                "checking out modified files", "done"};
+  if(progress > GIT_STASH_APPLY_PROGRESS_NONE && progress <= GIT_STASH_APPLY_PROGRESS_DONE)
+    REprintf("\rApplying stash: %-30s%s", steps[progress], progress == GIT_STASH_APPLY_PROGRESS_DONE ? "\n" : "");
+  return 0;
+}
+
+static void stash_checkout_progress(const char *path, size_t cur, size_t tot, void *payload){
+  if(cur > 0 && tot > 0)
+    REprintf("\rApplying stash: checked out %zu of %zu files", cur, tot);
+}
+
+SEXP R_git_stash_apply(SEXP ptr, SEXP index, SEXP reinstate_index, SEXP pop, SEXP verbose){
   size_t i = Rf_asInteger(index);
   git_repository *repo = get_git_repository(ptr);
   git_stash_apply_options opts = GIT_STASH_APPLY_OPTIONS_INIT;
-  bail_if(git_stash_pop(repo, i, &opts), "git_stash_pop");
+  if(Rf_asLogical(reinstate_index))
+    opts.flags |= GIT_STASH_APPLY_REINSTATE_INDEX;
+  set_checkout_notify_cb(&opts.checkout_options);
+  if(Rf_asLogical(verbose)){
+    opts.progress_cb = stash_progress_cb;
+    opts.checkout_options.progress_cb = stash_checkout_progress;
+  }
+  if(Rf_asLogical(pop)){
+    bail_if(git_stash_pop(repo, i, &opts), "git_stash_pop");
+  } else {
+    bail_if(git_stash_apply(repo, i, &opts), "git_stash_apply");
+  }
   return R_NilValue;
 }
 
@@ -31,32 +56,75 @@ SEXP R_git_stash_drop(SEXP ptr, SEXP index){
   return R_NilValue;
 }
 
-static int counter_cb(size_t i, const char* message, const git_oid *stash_id, void *payload){
-  int *count = payload;
-  (*count)++;
-  return 0;
-}
-
-static int stash_ls_cb(size_t i, const char* message, const git_oid *stash_id, void *payload){
-  SEXP df = payload;
-  INTEGER(VECTOR_ELT(df, 0))[i] = i;
-  SET_STRING_ELT(VECTOR_ELT(df, 1), i, safe_char(message));
-  SET_STRING_ELT(VECTOR_ELT(df, 2), i, safe_char(git_oid_tostr_s(stash_id)));
-  return 0;
+/* The stash is the reflog of refs/stash, with the most recent stash first */
+static git_commit *stash_commit(git_repository *repo, SEXP index){
+  git_reflog *reflog = NULL;
+  git_commit *commit = NULL;
+  size_t i = Rf_asInteger(index);
+  bail_if(git_reflog_read(&reflog, repo, "refs/stash"), "git_reflog_read");
+  const git_reflog_entry *entry = git_reflog_entry_byindex(reflog, i);
+  if(entry == NULL){
+    git_reflog_free(reflog);
+    Rf_error("No stash found at index %d", (int) i);
+  }
+  int res = git_commit_lookup(&commit, repo, git_reflog_entry_id_new(entry));
+  git_reflog_free(reflog);
+  bail_if(res, "git_commit_lookup");
+  return commit;
 }
 
 SEXP R_git_stash_list(SEXP ptr){
-  int count = 0;
+  git_reflog *reflog = NULL;
   git_repository *repo = get_git_repository(ptr);
-  git_stash_foreach(repo, counter_cb, &count);
-
+  bail_if(git_reflog_read(&reflog, repo, "refs/stash"), "git_reflog_read");
+  size_t count = git_reflog_entrycount(reflog);
   SEXP indexes = PROTECT(Rf_allocVector(INTSXP, count));
   SEXP messages = PROTECT(Rf_allocVector(STRSXP, count));
   SEXP oidstr = PROTECT(Rf_allocVector(STRSXP, count));
-  SEXP df = PROTECT(build_tibble(3, "index", indexes, "message", messages, "oid", oidstr));
+  for(size_t i = 0; i < count; i++){
+    const git_reflog_entry *entry = git_reflog_entry_byindex(reflog, i);
+    INTEGER(indexes)[i] = i;
+    SET_STRING_ELT(messages, i, safe_char(git_reflog_entry_message(entry)));
+    SET_STRING_ELT(oidstr, i, safe_char(git_oid_tostr_s(git_reflog_entry_id_new(entry))));
+  }
+  git_reflog_free(reflog);
+  SEXP df = build_tibble(3, "index", indexes, "message", messages, "oid", oidstr);
   UNPROTECT(3);
-  if(count > 0)
-    git_stash_foreach(repo, stash_ls_cb, df);
-  UNPROTECT(1);
   return df;
 }
+
+/* A stash commit has the HEAD it was based on as first parent, the index as second
+ * parent and the untracked files (if any) as third parent. The changes are diffed from
+ * the trees in the odb, so the working directory is not touched. */
+SEXP R_git_stash_show(SEXP ptr, SEXP index, SEXP untracked){
+  git_diff *diff = NULL;
+  git_tree *base_tree = NULL;
+  git_tree *stash_tree = NULL;
+  git_commit *base = NULL;
+  git_repository *repo = get_git_repository(ptr);
+  git_commit *stash = stash_commit(repo, index);
+  git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+  bail_if(git_commit_parent(&base, stash, 0), "git_commit_parent");
+  bail_if(git_commit_tree(&base_tree, base), "git_commit_tree");
+  bail_if(git_commit_tree(&stash_tree, stash), "git_commit_tree");
+  bail_if(git_diff_tree_to_tree(&diff, repo, base_tree, stash_tree, &opts), "git_diff_tree_to_tree");
+  if(Rf_asLogical(untracked) && git_commit_parentcount(stash) > 2){
+    git_commit *untracked_commit = NULL;
+    git_tree *untracked_tree = NULL;
+    git_diff *untracked_diff = NULL;
+    bail_if(git_commit_parent(&untracked_commit, stash, 2), "git_commit_parent");
+    bail_if(git_commit_tree(&untracked_tree, untracked_commit), "git_commit_tree");
+    bail_if(git_diff_tree_to_tree(&untracked_diff, repo, NULL, untracked_tree, &opts), "git_diff_tree_to_tree");
+    bail_if(git_diff_merge(diff, untracked_diff), "git_diff_merge");
+    git_diff_free(untracked_diff);
+    git_tree_free(untracked_tree);
+    git_commit_free(untracked_commit);
+  }
+  git_tree_free(base_tree);
+  git_tree_free(stash_tree);
+  git_commit_free(base);
+  git_commit_free(stash);
+  SEXP out = diff_to_tibble(diff);
+  git_diff_free(diff);
+  return out;
+}
@@ -1,45 +1,123 @@
 #include <string.h>
 #include "utils.h"
 
-static int submodule_count(git_submodule *submod, const char *name, void *payload){
-  int *count = payload;
-  *count = (*count) + 1;
+/* Submodules are collected in a single pass of git_submodule_foreach(). The callback
+ * runs inside libgit2, so it only copies into C memory. */
+typedef struct {
+  char *name;
+  char *path;
+  char *url;
+  char *branch;
+  char *head;
+} submodule_entry;
+
+typedef struct {
+  submodule_entry *entries;
+  size_t n;
+  size_t cap;
+} submodule_list;
+
+static char *copy_string(const char *str){
+  return str ? strdup(str) : NULL;
+}
+
+static int submodule_collect(git_submodule *sm, const char *name, void *payload){
+  submodule_list *list = payload;
+  if(list->n == list->cap){
+    size_t cap = list->cap ? 2 * list->cap : 16;
+    submodule_entry *entries = realloc(list->entries, cap * sizeof(submodule_entry));
+    if(entries == NULL)
+      return -1;
+    list->entries = entries;
+    list->cap = cap;
+  }
+  submodule_entry *entry = &list->entries[list->n++];
+  entry->name = copy_string(git_submodule_name(sm));
+  entry->path = copy_string(git_submodule_path(sm));
+  entry->url = copy_string(git_submodule_url(sm));
+  entry->branch = copy_string(git_submodule_branch(sm));
+  entry->head = copy_string(git_oid_tostr_s(git_submodule_head_id(sm)));
   return 0;
 }
 
-static int submodule_fill(git_submodule *sm, const char *name, void *payload){
-  SEXP df = payload;
-  SEXP names = VECTOR_ELT(df, 0);
-  SEXP paths = VECTOR_ELT(df, 1);
-  SEXP urls = VECTOR_ELT(df, 2);
-  SEXP branches = VECTOR_ELT(df, 3);
-  SEXP heads = VECTOR_ELT(df, 4);
-  for(int i = 0; i < Rf_length(names); i++){
-    if(Rf_length(STRING_ELT(names, i)) == 0){
-      SET_STRING_ELT(names, i, safe_char(git_submodule_name(sm)));
-      SET_STRING_ELT(paths, i, safe_char(git_submodule_path(sm)));
-      SET_STRING_ELT(urls, i, safe_char(git_submodule_url(sm)));
-      SET_STRING_ELT(branches, i, safe_char(git_submodule_branch(sm)));
-      SET_STRING_ELT(heads, i, safe_char(git_oid_tostr_s(git_submodule_head_id(sm))));
-      return 0;
-    }
+static void free_submodule_list(submodule_list *list){
+  for(size_t i = 0; i < list->n; i++){
+    free(list->entries[i].name);
+    free(list->entries[i].path);
+    free(list->entries[i].url);
+    free(list->entries[i].branch);
+    free(list->entries[i].head);
   }
-  return 1;
+  free(list->entries);
+}
+
+static const char *submodule_status_string(unsigned int status){
+  if(status & GIT_SUBMODULE_STATUS_INDEX_ADDED)
+    return "added";
+  if(status & GIT_SUBMODULE_STATUS_INDEX_DELETED)
+    return "deleted";
+  if(!(status & GIT_SUBMODULE_STATUS_IN_WD) || (status & GIT_SUBMODULE_STATUS_WD_UNINITIALIZED))
+    return "uninitialized";
+  if(status & (GIT_SUBMODULE_STATUS_INDEX_MODIFIED | GIT_SUBMODULE_STATUS_WD_MODIFIED))
+    return "modified";
+  if(status & (GIT_SUBMODULE_STATUS_WD_INDEX_MODIFIED | GIT_SUBMODULE_STATUS_WD_WD_MODIFIED |
+               GIT_SUBMODULE_STATUS_WD_UNTRACKED))
+    return "dirty";
+  return "clean";
 }
 
-SEXP R_git_submodule_list(SEXP ptr){
-  int n = 0;
+SEXP R_git_submodule_list(SEXP ptr, SEXP status){
+  submodule_list list = {0};
   git_repository *repo = get_git_repository(ptr);
-  git_submodule_foreach(repo, submodule_count, &n);
-  SEXP df = PROTECT(build_tibble(5,
-                         "name", PROTECT(Rf_allocVector(STRSXP, n)),
-                         "path", PROTECT(Rf_allocVector(STRSXP, n)),
-                         "url", PROTECT(Rf_allocVector(STRSXP, n)),
-                         "branch", PROTECT(Rf_allocVector(STRSXP, n)),
-                         "head", PROTECT(Rf_allocVector(STRSXP, n))));
-  git_submodule_foreach(repo, submodule_fill, df);
-  UNPROTECT(6);
-  return df;
+  int err = git_submodule_foreach(repo, submodule_collect, &list);
+  if(err < 0){
+    free_submodule_list(&list);
+    bail_if(err, "git_submodule_foreach");
+  }
+  int n = list.n;
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP paths = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP urls = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP branches = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP heads = PROTECT(Rf_allocVector(STRSXP, n));
+  for(int i = 0; i < n; i++){
+    SET_STRING_ELT(names, i, safe_char(list.entries[i].name));
+    SET_STRING_ELT(paths, i, safe_char(list.entries[i].path));
+    SET_STRING_ELT(urls, i, safe_char(list.entries[i].url));
+    SET_STRING_ELT(branches, i, safe_char(list.entries[i].branch));
+    SET_STRING_ELT(heads, i, safe_char(list.entries[i].head));
+  }
+  if(!Rf_asLogical(status)){
+    free_submodule_list(&list);
+    SEXP out = build_tibble(5, "name", names, "path", paths, "url", urls, "branch", branches, "head", heads);
+    UNPROTECT(5);
+    return out;
+  }
+
+  /* The status looks into the working directory of each submodule, which is the slow part */
+  SEXP states = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP workdirs = PROTECT(Rf_allocVector(STRSXP, n));
+  for(int i = 0; i < n; i++){
+    unsigned int flags = 0;
+    git_submodule *sm = NULL;
+    const char *name = list.entries[i].name;
+    if(git_submodule_status(&flags, repo, name, GIT_SUBMODULE_IGNORE_UNSPECIFIED) < 0 ||
+       git_submodule_lookup(&sm, repo, name) < 0){
+      giterr_clear();
+      SET_STRING_ELT(states, i, NA_STRING);
+      SET_STRING_ELT(workdirs, i, NA_STRING);
+      continue;
+    }
+    const git_oid *wd = git_submodule_wd_id(sm);
+    SET_STRING_ELT(states, i, safe_char(submodule_status_string(flags)));
+    SET_STRING_ELT(workdirs, i, wd ? safe_char(git_oid_tostr_s(wd)) : NA_STRING);
+    git_submodule_free(sm);
+  }
+  free_submodule_list(&list);
+  SEXP out = build_tibble(7, "name", names, "path", paths, "url", urls, "branch", branches, "head", heads,
+                          "status", states, "workdir", workdirs);
+  UNPROTECT(7);
+  return out;
 }
 
 SEXP R_git_submodule_info(SEXP ptr, SEXP name){
@@ -62,8 +140,10 @@ SEXP R_git_submodule_init(SEXP ptr, SEXP name, SEXP overwrite){
   git_submodule *sm = NULL;
   bail_if(git_submodule_lookup(&sm, repo, CHAR(STRING_ELT(name, 0))), "git_submodule_lookup");
   bail_if(git_submodule_init(sm, Rf_asLogical(overwrite)), "git_submodule_init");
-  SEXP path = safe_string(git_submodule_path(sm));
+  SEXP path = PROTECT(safe_string(git_submodule_path(sm)));
   git_submodule_free(sm);
+  refresh_submodule_cache(ptr);
+  UNPROTECT(1);
   return path;
 }
 
@@ -73,8 +153,10 @@ SEXP R_git_submodule_update(SEXP ptr, SEXP name, SEXP init){
   bail_if(git_submodule_lookup(&sm, repo, CHAR(STRING_ELT(name, 0))), "git_submodule_lookup");
   git_submodule_update_options opt = GIT_SUBMODULE_UPDATE_OPTIONS_INIT;
   bail_if(git_submodule_update(sm, Rf_asLogical(init), &opt), "git_submodule_update");
-  SEXP path = safe_string(git_submodule_path(sm));
+  SEXP path = PROTECT(safe_string(git_submodule_path(sm)));
   git_submodule_free(sm);
+  refresh_submodule_cache(ptr);
+  UNPROTECT(1);
   return path;
 }
 
@@ -86,6 +168,7 @@ SEXP R_git_submodule_setup(SEXP ptr, SEXP url, SEXP path){
   git_repository *subrepo = NULL;
   bail_if(git_submodule_open(&subrepo, sm), "git_submodule_open");
   git_submodule_free(sm);
+  refresh_submodule_cache(ptr);
   return new_git_repository(subrepo);
 }
 
@@ -95,6 +178,7 @@ SEXP R_git_submodule_save(SEXP ptr, SEXP submodule){
   bail_if(git_submodule_lookup(&sm, repo, CHAR(STRING_ELT(submodule, 0))), "git_submodule_lookup");
   bail_if(git_submodule_add_finalize(sm), "git_submodule_add_finalize");
   git_submodule_free(sm);
+  refresh_submodule_cache(ptr);
   return submodule;
 }
 
@@ -112,5 +196,6 @@ SEXP R_git_submodule_set_to(SEXP ptr, SEXP submodule, SEXP oid){
   git_index_write(index);
   git_index_free(index);
   git_submodule_free(sm);
+  refresh_submodule_cache(ptr);
   return oid;
 }
@@ -5,6 +5,11 @@
 #define GIT_OBJECT_COMMIT GIT_OBJ_COMMIT
 #endif
 
+#ifndef GIT_OBJECT_TREE
+#define GIT_OBJECT_TREE GIT_OBJ_TREE
+#define GIT_OBJECT_BLOB GIT_OBJ_BLOB
+#endif
+
 void warn_last_msg(void);
 void bail_if(int err, const char *what);
 void bail_if_null(void * ptr, const char * what);
@@ -12,6 +17,7 @@ SEXP string_or_null(const char *x);
 SEXP safe_string(const char *x);
 SEXP safe_char(const char *x);
 SEXP make_strvec(int n, ...);
+SEXP make_author(const git_signature *p);
 SEXP build_list(int n, ...);
 SEXP list_to_tibble(SEXP df);
 SEXP new_git_repository(git_repository *repo);
@@ -20,6 +26,7 @@ git_object *resolve_refish(SEXP string, git_repository *repo);
 git_commit *ref_to_commit(SEXP ref, git_repository *repo);
 git_branch_t r_branch_type(SEXP local);
 git_strarray *files_to_array(SEXP files);
+git_reference **collect_references(git_repository *repo, const char *glob, size_t *len);
 
 #define build_tibble(...) list_to_tibble(build_list( __VA_ARGS__))
 
@@ -33,3 +40,51 @@ git_strarray *files_to_array(SEXP files);
 #endif
 
 void set_checkout_notify_cb(git_checkout_options *opts);
+
+/* Sparse checkout, see sparse.c */
+int sparse_checkout_paths(git_repository *repo, git_strarray *out);
+void set_checkout_sparse(git_checkout_options *opts, git_repository *repo);
+void sparse_checkout_sync(git_repository *repo, git_object *treeish);
+void sparse_checkout_save(git_repository *repo, SEXP patterns);
+
+/* Submodule cache of repository handles, see clone.c */
+void set_submodule_cache(SEXP ptr, int enable);
+void refresh_submodule_cache(SEXP ptr);
+
+/* Table of changed files and patches, see commit.c */
+SEXP diff_to_tibble(git_diff *diff);
+
+/* Conflicted paths of an index, see conflicts.c */
+SEXP conflict_paths(git_index *index);
+
+/* Parallel checkout, see checkout.c */
+SEXP checkout_tree_parallel(git_repository *repo, git_object *treeish, int force, int nthreads);
+
+/* Thread pool and background jobs, see parallel.c */
+typedef void (*gert_task_fn)(void *data, int i);
+typedef struct gert_job gert_job;
+void gert_parallel_init(void);
+int gert_parallel_run(int ntasks, int nthreads, gert_task_fn fn, void *data);
+int gert_parallel_cancelled(void);
+int gert_run_on_main(int (*fn)(void *arg), void *arg, volatile int *cancel);
+void gert_service_main_queue(void);
+gert_job *gert_job_start(void (*fn)(void *data), void *data, void (*free_fn)(void *data));
+int gert_job_done(gert_job *job);
+void gert_job_release(gert_job *job);
+double gert_time_now(void);
+int gert_pending_interrupt(void);
+
+/* Credential cache, see credcache.c */
+typedef enum {GERT_CRED_USERPASS, GERT_CRED_SSH_KEY} gert_cred_type;
+typedef struct {
+  char *username;
+  char *password;
+  char *pubkey_path;
+  char *key_path;
+} gert_cred;
+int gert_cred_cache_get(gert_cred_type type, const char *url, const char *scope,
+                        const char *username, gert_cred *out);
+void gert_cred_cache_put(gert_cred_type type, const char *url, const char *scope, const gert_cred *cred);
+void gert_cred_cache_drop(gert_cred_type type, const char *url, const char *scope, const char *username);
+void gert_cred_clear(gert_cred *cred);
+void gert_wipe_string(char *str);
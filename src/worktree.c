@@ -1,3 +1,4 @@
+#include <string.h>
 #include "utils.h"
 
 // Note that `valid` and `locked` only report `TRUE` if the column is known to
@@ -38,6 +39,185 @@ SEXP R_git_worktree_list(SEXP ptr) {
   return out;
 }
 
+// Overview of all worktrees in parallel. Each task opens its own handle of the
+// main repository, because a `git_repository` must not be shared between
+// threads. The worktree is then opened with `git_repository_open_from_worktree()`
+// to read its HEAD and count its changes. Tasks only fill C memory.
+typedef struct {
+  const char *commondir;
+  const char *name;
+  int include_untracked;
+  int found;
+  int valid;
+  int locked;
+  int detached;
+  int staged;
+  int unstaged;
+  int untracked;
+  int conflicts;
+  int error;
+  char *path;
+  char *lock_reason;
+  char *branch;
+  char head[GIT_OID_HEXSZ + 1];
+  char message[1000];
+} worktree_task;
+
+static void count_changes(worktree_task *task, git_status_list *list) {
+  for (size_t i = 0; i < git_status_list_entrycount(list); i++) {
+    unsigned int status = git_status_byindex(list, i)->status;
+    if (status & GIT_STATUS_CONFLICTED) {
+      task->conflicts++;
+      continue;
+    }
+    if (status & (GIT_STATUS_INDEX_NEW | GIT_STATUS_INDEX_MODIFIED | GIT_STATUS_INDEX_DELETED |
+                  GIT_STATUS_INDEX_RENAMED | GIT_STATUS_INDEX_TYPECHANGE)) {
+      task->staged++;
+    }
+    if (status & (GIT_STATUS_WT_MODIFIED | GIT_STATUS_WT_DELETED | GIT_STATUS_WT_RENAMED |
+                  GIT_STATUS_WT_TYPECHANGE)) {
+      task->unstaged++;
+    }
+    if (status & GIT_STATUS_WT_NEW) {
+      task->untracked++;
+    }
+  }
+}
+
+static int inspect_worktree(worktree_task *task, git_repository *repo) {
+  git_buf reason = {0};
+  git_worktree *worktree = NULL;
+  git_repository *wtrepo = NULL;
+  git_reference *head = NULL;
+  git_status_list *list = NULL;
+  int err = git_worktree_lookup(&worktree, repo, task->name);
+  if (err) {
+    return err;
+  }
+  task->found = 1;
+  task->path = strdup(git_worktree_path(worktree));
+  task->valid = git_worktree_validate(worktree) == GIT_OK;
+  giterr_clear();
+  task->locked = git_worktree_is_locked(&reason, worktree) > 0;
+  if (task->locked && reason.size > 0) {
+    task->lock_reason = strdup(reason.ptr);
+  }
+  git_buf_free(&reason);
+  err = git_repository_open_from_worktree(&wtrepo, worktree);
+  if (!err) {
+    // An unborn branch has no HEAD yet, which is not an error here
+    task->detached = git_repository_head_detached(wtrepo) == 1;
+    if (git_repository_head(&head, wtrepo) == 0) {
+      git_oid_tostr(task->head, sizeof(task->head), git_reference_target(head));
+      if (!task->detached) {
+        task->branch = strdup(git_reference_shorthand(head));
+      }
+    }
+    giterr_clear();
+    git_status_options opts = GIT_STATUS_OPTIONS_INIT;
+    opts.show = GIT_STATUS_SHOW_INDEX_AND_WORKDIR;
+    if (task->include_untracked) {
+      opts.flags |= GIT_STATUS_OPT_INCLUDE_UNTRACKED;
+    }
+    err = git_status_list_new(&list, wtrepo, &opts);
+  }
+  if (!err) {
+    count_changes(task, list);
+  }
+  git_status_list_free(list);
+  git_reference_free(head);
+  git_repository_free(wtrepo);
+  git_worktree_free(worktree);
+  return err;
+}
+
+static void run_worktree_task(void *data, int i) {
+  worktree_task *task = (worktree_task *) data + i;
+  git_repository *repo = NULL;
+  if (gert_parallel_cancelled()) {
+    return;
+  }
+  int err = git_repository_open(&repo, task->commondir);
+  if (!err) {
+    err = inspect_worktree(task, repo);
+  }
+  if (err) {
+    const git_error *info = giterr_last();
+    snprintf(task->message, sizeof(task->message), "%s", info ? info->message : "Unknown error");
+  }
+  task->error = err;
+  git_repository_free(repo);
+}
+
+SEXP R_git_worktree_status(SEXP ptr, SEXP untracked, SEXP threads) {
+  git_strarray worktrees = {0};
+  git_repository *repo = get_git_repository(ptr);
+  bail_if(git_worktree_list(&worktrees, repo), "git_worktree_list");
+  int len = worktrees.count;
+  worktree_task *tasks = (worktree_task *) R_alloc(len, sizeof(worktree_task));
+  memset(tasks, 0, len * sizeof(worktree_task));
+  for (int i = 0; i < len; i++) {
+    tasks[i].commondir = git_repository_commondir(repo);
+    tasks[i].name = worktrees.strings[i];
+    tasks[i].include_untracked = Rf_asLogical(untracked);
+  }
+  int interrupted = gert_parallel_run(len, Rf_asInteger(threads), run_worktree_task, tasks);
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP paths = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP valid = PROTECT(Rf_allocVector(LGLSXP, len));
+  SEXP locked = PROTECT(Rf_allocVector(LGLSXP, len));
+  SEXP reasons = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP heads = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP branches = PROTECT(Rf_allocVector(STRSXP, len));
+  SEXP detached = PROTECT(Rf_allocVector(LGLSXP, len));
+  SEXP staged = PROTECT(Rf_allocVector(INTSXP, len));
+  SEXP unstaged = PROTECT(Rf_allocVector(INTSXP, len));
+  SEXP untracked_out = PROTECT(Rf_allocVector(INTSXP, len));
+  SEXP conflicts = PROTECT(Rf_allocVector(INTSXP, len));
+  SEXP messages = PROTECT(Rf_allocVector(STRSXP, len));
+  for (int i = 0; i < len; i++) {
+    worktree_task *task = &tasks[i];
+    SET_STRING_ELT(names, i, safe_char(task->name));
+    SET_STRING_ELT(paths, i, safe_char(task->path));
+    SET_LOGICAL_ELT(valid, i, task->found ? task->valid : NA_LOGICAL);
+    SET_LOGICAL_ELT(locked, i, task->found ? task->locked : NA_LOGICAL);
+    SET_STRING_ELT(reasons, i, safe_char(task->lock_reason));
+    SET_STRING_ELT(heads, i, task->head[0] ? safe_char(task->head) : NA_STRING);
+    SET_STRING_ELT(branches, i, safe_char(task->branch));
+    SET_LOGICAL_ELT(detached, i, task->error ? NA_LOGICAL : task->detached);
+    INTEGER(staged)[i] = task->error ? NA_INTEGER : task->staged;
+    INTEGER(unstaged)[i] = task->error ? NA_INTEGER : task->unstaged;
+    INTEGER(untracked_out)[i] = task->error || !task->include_untracked ? NA_INTEGER : task->untracked;
+    INTEGER(conflicts)[i] = task->error ? NA_INTEGER : task->conflicts;
+    SET_STRING_ELT(messages, i, task->error ? safe_char(task->message) : NA_STRING);
+    free(task->path);
+    free(task->lock_reason);
+    free(task->branch);
+  }
+  git_strarray_free(&worktrees);
+  if (interrupted) {
+    Rf_error("Worktree status was interrupted by the user");
+  }
+  SEXP out = build_tibble(
+    13,
+    "name", names,
+    "path", paths,
+    "valid", valid,
+    "locked", locked,
+    "lock_reason", reasons,
+    "head", heads,
+    "branch", branches,
+    "detached", detached,
+    "staged", staged,
+    "unstaged", unstaged,
+    "untracked", untracked_out,
+    "conflicts", conflicts,
+    "message", messages
+  );
+  UNPROTECT(13);
+  return out;
+}
+
 SEXP R_git_worktree_exists(SEXP ptr, SEXP name) {
   git_repository *repo = get_git_repository(ptr);
   git_worktree *worktree = NULL;